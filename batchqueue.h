@@ -0,0 +1,64 @@
+#ifndef BATCHQUEUE_H
+#define BATCHQUEUE_H
+
+#include <QMutex>
+#include <QQueue>
+#include <QWaitCondition>
+
+// Bounded multi-producer queue; push blocks while full, pop blocks while empty.
+template <typename T>
+class BatchQueue
+{
+public:
+    explicit BatchQueue(int capacity)
+        : capacity(capacity)
+    {}
+
+    void push(T item)
+    {
+        QMutexLocker locker(&mutex);
+        while (queue.size() >= capacity && !closed)
+            notFull.wait(&mutex);
+        if (closed)
+            return;
+        queue.enqueue(std::move(item));
+        notEmpty.wakeOne();
+    }
+
+    // Returns false once the queue is closed and drained.
+    bool pop(T &item)
+    {
+        QMutexLocker locker(&mutex);
+        while (queue.isEmpty() && !closed)
+            notEmpty.wait(&mutex);
+        if (queue.isEmpty())
+            return false;
+        item = queue.dequeue();
+        notFull.wakeOne();
+        return true;
+    }
+
+    bool isEmpty()
+    {
+        QMutexLocker locker(&mutex);
+        return queue.isEmpty();
+    }
+
+    void close()
+    {
+        QMutexLocker locker(&mutex);
+        closed = true;
+        notEmpty.wakeAll();
+        notFull.wakeAll();
+    }
+
+private:
+    QMutex mutex;
+    QWaitCondition notEmpty;
+    QWaitCondition notFull;
+    QQueue<T> queue;
+    int capacity;
+    bool closed = false;
+};
+
+#endif // BATCHQUEUE_H
@@ -0,0 +1,493 @@
+#include "weatherdatagenerator.h"
+#include "weather.h"
+#include "weathercsvparser.h"
+#include "weatherdatabase.h"
+#include "weatheringestor.h"
+#include "weathermodel.h"
+#include "weatherproxymodel.h"
+#include "weatherstore.h"
+#include "weatherutil.h"
+#include "weatherwindow.h"
+#include "querymodel.h"
+#include <QDir>
+#include <QMap>
+#include <QTemporaryDir>
+#include <QtTest>
+
+namespace {
+// Rows per data set, e.g. WEATHER_BENCHMARK_ROWS=1K,1M,100M
+const char *const defaultSizes = "1K,100K";
+// Paths that materialize every row in memory stop here, the rest run over the whole table
+const int materializedRows = 1000000;
+const int sampleLines = 10000;
+
+qint64 parseSize(QByteArray text)
+{
+    qint64 factor = 1;
+    if (text.endsWith('K'))
+        factor = 1000;
+    else if (text.endsWith('M'))
+        factor = 1000000;
+    if (factor > 1)
+        text.chop(1);
+
+    bool ok = false;
+    const qint64 value = text.toLongLong(&ok);
+    return ok && value > 0 ? value * factor : 0;
+}
+
+QString sizeName(qint64 rows)
+{
+    if (rows % 1000000 == 0)
+        return QString("%1M").arg(rows / 1000000);
+    if (rows % 1000 == 0)
+        return QString("%1K").arg(rows / 1000);
+    return QString::number(rows);
+}
+}
+
+// Hot paths over synthetic data, run with -o results.xml,xml or -csv for machine-readable output.
+class WeatherBenchmark : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void cleanup();
+
+    void parseLine();
+    void parseFiles_data();
+    void parseFiles();
+    void ingest_data();
+    void ingest();
+    void select_data();
+    void select();
+    void selectResult_data();
+    void selectResult();
+    void temperatureStatistics_data();
+    void temperatureStatistics();
+    void storeAggregate_data();
+    void storeAggregate();
+    void rollingWindow_data();
+    void rollingWindow();
+    void sketchPercentiles_data();
+    void sketchPercentiles();
+    void modelData_data();
+    void modelData();
+    void modelSort_data();
+    void modelSort();
+    void proxySort_data();
+    void proxySort();
+    void proxyFilter_data();
+    void proxyFilter();
+    void proxyColumnFilter_data();
+    void proxyColumnFilter();
+
+private:
+    // Generated CSV files and an ingested weather.db per row count, built on first use
+    struct DataSet
+    {
+        QString directory;
+        QStringList files;
+        bool ingested = false;
+    };
+
+    void addSizes();
+    DataSet &dataSet(qint64 rows);
+    DataSet &ingestedDataSet(qint64 rows);
+
+    QTemporaryDir workDirectory;
+    QString originalDirectory;
+    QList<qint64> sizes;
+    QMap<qint64, DataSet> dataSets;
+};
+
+void WeatherBenchmark::initTestCase()
+{
+    QVERIFY(workDirectory.isValid());
+    originalDirectory = QDir::currentPath();
+
+    const QByteArray configured = qEnvironmentVariable("WEATHER_BENCHMARK_ROWS", defaultSizes).toLatin1();
+    for (const QByteArray &text : configured.split(',')) {
+        const qint64 rows = parseSize(text.trimmed().toUpper());
+        if (rows > 0 && !sizes.contains(rows))
+            sizes << rows;
+    }
+    QVERIFY2(!sizes.isEmpty(), "WEATHER_BENCHMARK_ROWS has no valid row count");
+    std::sort(sizes.begin(), sizes.end());
+}
+
+void WeatherBenchmark::cleanupTestCase()
+{
+    // WeatherUtil works on weather.db in the current directory
+    QDir::setCurrent(originalDirectory);
+}
+
+// Each benchmark opens its own connection instead of inheriting a warm page cache
+void WeatherBenchmark::cleanup()
+{
+    WeatherDatabase::release("weather.db");
+}
+
+void WeatherBenchmark::addSizes()
+{
+    QTest::addColumn<qint64>("rows");
+    for (qint64 rows : std::as_const(sizes))
+        QTest::newRow(qPrintable(sizeName(rows))) << rows;
+}
+
+WeatherBenchmark::DataSet &WeatherBenchmark::dataSet(qint64 rows)
+{
+    DataSet &set = dataSets[rows];
+    if (set.directory.isEmpty()) {
+        set.directory = workDirectory.filePath(sizeName(rows));
+        set.files = WeatherDataGenerator().writeFiles(set.directory + "/csv", rows);
+    }
+    return set;
+}
+
+WeatherBenchmark::DataSet &WeatherBenchmark::ingestedDataSet(qint64 rows)
+{
+    DataSet &set = dataSet(rows);
+    if (!set.ingested) {
+        const QString database = QDir(set.directory).filePath("weather.db");
+        if (WeatherDatabase::initialize(database))
+            set.ingested = WeatherIngestor(database).ingest(set.files) == rows;
+    }
+    QDir::setCurrent(set.directory);
+    return set;
+}
+
+void WeatherBenchmark::parseLine()
+{
+    const QByteArray rows = WeatherDataGenerator().rows(0, sampleLines);
+    QStringList lines;
+    for (const QByteArray &line : rows.split('\n')) {
+        if (!line.isEmpty())
+            lines << QString::fromLatin1(line);
+    }
+
+    Weather weather;
+    QBENCHMARK {
+        for (const QString &line : std::as_const(lines))
+            weather.parse(line);
+    }
+}
+
+void WeatherBenchmark::parseFiles_data()
+{
+    addSizes();
+}
+
+void WeatherBenchmark::parseFiles()
+{
+    QFETCH(qint64, rows);
+    const DataSet &set = dataSet(rows);
+    QVERIFY(!set.files.isEmpty());
+
+    qint64 parsed = 0;
+    QBENCHMARK {
+        parsed = 0;
+        for (const QString &file : set.files) {
+            WeatherCsvParser parser(file);
+            QVERIFY(parser.open());
+            WeatherRecord record;
+            while (parser.readNext(record))
+                ++parsed;
+        }
+    }
+    QCOMPARE(parsed, rows);
+}
+
+void WeatherBenchmark::ingest_data()
+{
+    addSizes();
+}
+
+// Parse, deduplicate and commit into an empty database, statistics and rollups included
+void WeatherBenchmark::ingest()
+{
+    QFETCH(qint64, rows);
+    const DataSet &set = dataSet(rows);
+
+    const QString database = QDir(set.directory).filePath("ingest.db");
+    QFile::remove(database);
+    QVERIFY(WeatherDatabase::initialize(database));
+
+    qint64 inserted = 0;
+    QBENCHMARK_ONCE {
+        inserted = WeatherIngestor(database).ingest(set.files);
+    }
+    QCOMPARE(inserted, rows);
+    WeatherDatabase::release(database);
+    QFile::remove(database);
+}
+
+void WeatherBenchmark::select_data()
+{
+    addSizes();
+}
+
+void WeatherBenchmark::select()
+{
+    QFETCH(qint64, rows);
+    QVERIFY(ingestedDataSet(rows).ingested);
+
+    WeatherUtil util;
+    const QString sql = QString("SELECT * FROM weather ORDER BY time LIMIT %1").arg(materializedRows);
+    qint64 selected = 0;
+    QBENCHMARK {
+        selected = util.select(sql).size();
+    }
+    QCOMPARE(selected, qMin<qint64>(rows, materializedRows));
+}
+
+void WeatherBenchmark::selectResult_data()
+{
+    addSizes();
+}
+
+void WeatherBenchmark::selectResult()
+{
+    QFETCH(qint64, rows);
+    QVERIFY(ingestedDataSet(rows).ingested);
+
+    WeatherUtil util;
+    const QString sql = QString("SELECT * FROM weather ORDER BY time LIMIT %1").arg(materializedRows);
+    int selected = 0;
+    QBENCHMARK {
+        selected = util.selectResult(sql).rowCount();
+    }
+    QCOMPARE(selected, int(qMin<qint64>(rows, materializedRows)));
+}
+
+void WeatherBenchmark::temperatureStatistics_data()
+{
+    addSizes();
+}
+
+void WeatherBenchmark::temperatureStatistics()
+{
+    QFETCH(qint64, rows);
+    QVERIFY(ingestedDataSet(rows).ingested);
+
+    WeatherUtil util;
+    double sum = 0.0;
+    QBENCHMARK {
+        QVERIFY(util.reloadStatistics());
+        sum += util.highestTemp() + util.avgTemp() + util.lowestTemp();
+    }
+    QVERIFY(qIsFinite(sum));
+}
+
+void WeatherBenchmark::storeAggregate_data()
+{
+    addSizes();
+}
+
+// Full-column scans over the in-memory store, what the chart and range statistics run on
+void WeatherBenchmark::storeAggregate()
+{
+    QFETCH(qint64, rows);
+    QVERIFY(ingestedDataSet(rows).ingested);
+
+    WeatherUtil util;
+    QVERIFY(util.reloadStore());
+    const WeatherStore &store = util.weatherStore();
+    QCOMPARE(qint64(store.size()), rows);
+
+    double sum = 0.0;
+    QBENCHMARK {
+        for (int column = 0; column < WeatherStore::ColumnCount; ++column)
+            sum += store.aggregate(static_cast<WeatherStore::Column>(column)).mean();
+    }
+    QVERIFY(qIsFinite(sum));
+}
+
+void WeatherBenchmark::rollingWindow_data()
+{
+    addSizes();
+}
+
+// Fresh 7, 30 and 365 day windows over the whole store, the chart overlays; the cost must not grow with the window
+void WeatherBenchmark::rollingWindow()
+{
+    QFETCH(qint64, rows);
+    QVERIFY(ingestedDataSet(rows).ingested);
+
+    WeatherUtil util;
+    QVERIFY(util.reloadStore());
+    const WeatherStore &store = util.weatherStore();
+
+    qint64 computed = 0;
+    QBENCHMARK {
+        for (int days : { 7, 30, 365 }) {
+            WeatherWindow window(WeatherStore::AverageTemperature, days);
+            window.extend(store);
+            computed += window.size();
+        }
+    }
+    QVERIFY(computed >= 3 * rows);
+}
+
+void WeatherBenchmark::sketchPercentiles_data()
+{
+    addSizes();
+}
+
+// P5 to P99 of the sketched columns over all stored days, merged from the bucket sketches
+void WeatherBenchmark::sketchPercentiles()
+{
+    QFETCH(qint64, rows);
+    QVERIFY(ingestedDataSet(rows).ingested);
+
+    WeatherUtil util;
+    QVERIFY(util.reloadStore());
+    const WeatherStore &store = util.weatherStore();
+    const qint64 from = qint64(store.day(0)) * 86400;
+    const qint64 to = (qint64(store.day(store.size() - 1)) + 1) * 86400;
+
+    double sum = 0.0;
+    qint64 counted = 0;
+    QBENCHMARK {
+        counted = 0;
+        for (WeatherStore::Column column : WeatherSketches::columns) {
+            const WeatherSketch sketch = util.sketch(column, from, to);
+            counted += sketch.count();
+            for (double q : { 0.05, 0.5, 0.95, 0.99 })
+                sum += sketch.quantile(q);
+        }
+    }
+    QVERIFY(counted > 0);
+    QVERIFY(qIsFinite(sum));
+}
+
+void WeatherBenchmark::modelData_data()
+{
+    addSizes();
+}
+
+// Every cell of the fetched rows, cached pages are evicted and re-read like while scrolling
+void WeatherBenchmark::modelData()
+{
+    QFETCH(qint64, rows);
+    QVERIFY(ingestedDataSet(rows).ingested);
+
+    WeatherUtil util;
+    WeatherModel model;
+    model.setDatabase(util.database());
+    while (model.rowCount() < materializedRows && model.canFetchMore(QModelIndex()))
+        model.fetchMore(QModelIndex());
+    QVERIFY(model.rowCount() > 0);
+
+    qsizetype characters = 0;
+    QBENCHMARK {
+        for (int row = 0; row < model.rowCount(); ++row) {
+            for (int column = 0; column < model.columnCount(); ++column)
+                characters += model.data(model.index(row, column)).toString().size();
+        }
+    }
+    QVERIFY(characters > 0);
+}
+
+void WeatherBenchmark::modelSort_data()
+{
+    addSizes();
+}
+
+// The proxy hands sorting to WeatherModel, which pages through the table in SQL order
+void WeatherBenchmark::modelSort()
+{
+    QFETCH(qint64, rows);
+    QVERIFY(ingestedDataSet(rows).ingested);
+
+    WeatherUtil util;
+    WeatherModel model;
+    model.setDatabase(util.database());
+    WeatherProxyModel proxy;
+    proxy.setSourceModel(&model);
+
+    Qt::SortOrder order = Qt::AscendingOrder;
+    QBENCHMARK {
+        order = order == Qt::AscendingOrder ? Qt::DescendingOrder : Qt::AscendingOrder;
+        proxy.sort(WeatherStore::AverageTemperature + 1, order);
+        QVERIFY(proxy.data(proxy.index(0, 0)).isValid());
+    }
+}
+
+void WeatherBenchmark::proxySort_data()
+{
+    addSizes();
+}
+
+// In-memory sorting over a query result, as in the Query tab
+void WeatherBenchmark::proxySort()
+{
+    QFETCH(qint64, rows);
+    QVERIFY(ingestedDataSet(rows).ingested);
+
+    WeatherUtil util;
+    QueryModel model;
+    model.setData(util.selectResult(QString("SELECT * FROM weather LIMIT %1").arg(materializedRows)));
+    WeatherProxyModel proxy;
+    proxy.setSourceModel(&model);
+
+    // A changed order always re-sorts, the same one may be a no-op in QSortFilterProxyModel
+    Qt::SortOrder order = Qt::AscendingOrder;
+    QBENCHMARK {
+        order = order == Qt::AscendingOrder ? Qt::DescendingOrder : Qt::AscendingOrder;
+        proxy.sort(WeatherStore::AverageTemperature + 2, order);
+    }
+    QCOMPARE(proxy.rowCount(), model.rowCount());
+}
+
+void WeatherBenchmark::proxyFilter_data()
+{
+    addSizes();
+}
+
+void WeatherBenchmark::proxyFilter()
+{
+    QFETCH(qint64, rows);
+    QVERIFY(ingestedDataSet(rows).ingested);
+
+    WeatherUtil util;
+    QueryModel model;
+    model.setData(util.selectResult(QString("SELECT date, averageTemperature FROM weather LIMIT %1").arg(materializedRows)));
+    WeatherProxyModel proxy;
+    proxy.setSourceModel(&model);
+    proxy.setFilterColumn(0);
+
+    QBENCHMARK {
+        proxy.setFilterString("-06-");
+    }
+    QVERIFY(proxy.rowCount() > 0 || model.rowCount() < 1000);
+}
+
+void WeatherBenchmark::proxyColumnFilter_data()
+{
+    addSizes();
+}
+
+// Typed predicates compiled into the selection bitmap
+void WeatherBenchmark::proxyColumnFilter()
+{
+    QFETCH(qint64, rows);
+    QVERIFY(ingestedDataSet(rows).ingested);
+
+    WeatherUtil util;
+    QueryModel model;
+    model.setData(util.selectResult(QString("SELECT * FROM weather LIMIT %1").arg(materializedRows)));
+    WeatherProxyModel proxy;
+    proxy.setSourceModel(&model);
+
+    QBENCHMARK {
+        QVERIFY(proxy.setFilterExpression("tmax > 15 and prcp > 10"));
+    }
+    QVERIFY(proxy.rowCount() < model.rowCount());
+}
+
+QTEST_GUILESS_MAIN(WeatherBenchmark)
+
+#include "weatherbenchmark.moc"
@@ -0,0 +1,103 @@
+#include "weatherdatagenerator.h"
+#include "weatherrecord.h"
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <cmath>
+#include <cstdio>
+
+namespace {
+const int rowSeconds = 60;
+const int flushBytes = 1 << 20;
+// Roughly one gap in thirty values, like the real station data
+const int missingPercent = 3;
+const double pi = 3.14159265358979323846;
+}
+
+WeatherDataGenerator::WeatherDataGenerator(quint32 seed)
+    : seed(seed)
+    , random(seed)
+{
+}
+
+QByteArray WeatherDataGenerator::header() const
+{
+    return "date,tavg,tmin,tmax,prcp,snow,wdir,wspd,wpgt,pres,tsun\n";
+}
+
+QByteArray WeatherDataGenerator::rows(qint64 first, qint64 count)
+{
+    // Values depend on the row only, so any range can be produced on its own
+    QByteArray out;
+    out.reserve(count * 64);
+    for (qint64 row = first; row < first + count; ++row)
+        appendRow(out, row);
+    return out;
+}
+
+QStringList WeatherDataGenerator::writeFiles(const QString &directoryPath, qint64 count, qint64 rowsPerFile)
+{
+    QStringList files;
+    QDir().mkpath(directoryPath);
+
+    for (qint64 first = 0; first < count; first += rowsPerFile) {
+        const QString path = QDir(directoryPath).filePath(QString("synthetic-%1.csv").arg(files.size(), 5, 10, QChar('0')));
+        QFile file(path);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            qWarning() << "Could not write" << path << file.errorString();
+            return QStringList();
+        }
+
+        QByteArray buffer = header();
+        const qint64 last = qMin(count, first + rowsPerFile);
+        for (qint64 row = first; row < last; ++row) {
+            appendRow(buffer, row);
+            if (buffer.size() >= flushBytes) {
+                file.write(buffer);
+                buffer.clear();
+            }
+        }
+        file.write(buffer);
+        files << path;
+    }
+    return files;
+}
+
+void WeatherDataGenerator::appendRow(QByteArray &out, qint64 row)
+{
+    random.seed(seed + quint32(row) * 0x9E3779B9u);
+
+    const qint64 timestamp = row * rowSeconds;
+    int year, month, day;
+    WeatherRecord::civilFromDays(WeatherRecord::dayOf(timestamp), year, month, day);
+    const int seconds = static_cast<int>(timestamp - qint64(WeatherRecord::dayOf(timestamp)) * 86400);
+    char date[20];
+    std::snprintf(date, sizeof(date), "%04d-%02d-%02d %02d:%02d:%02d",
+                  year, month, day, seconds / 3600, seconds / 60 % 60, seconds % 60);
+    out.append(date);
+
+    // Seasonal temperature curve with noise, the other columns are plausible but independent
+    const double season = std::sin(2.0 * pi * (WeatherRecord::dayOf(timestamp) % 365) / 365.25);
+    const double average = 10.0 + 10.0 * season + random.bounded(-30, 31) / 10.0;
+    const double windSpeed = random.bounded(0, 400) / 10.0;
+    const double values[WeatherRecord::FieldCount] = {
+        average,
+        average - random.bounded(0, 60) / 10.0,
+        average + random.bounded(0, 60) / 10.0,
+        random.bounded(100) < 70 ? 0.0 : random.bounded(0, 300) / 10.0,
+        double(season < -0.5 && random.bounded(100) < 20 ? random.bounded(1, 30) : 0),
+        double(random.bounded(0, 360)),
+        windSpeed,
+        windSpeed + random.bounded(0, 300) / 10.0,
+        990.0 + random.bounded(0, 500) / 10.0,
+        double(random.bounded(0, 600))
+    };
+    static const int decimals[WeatherRecord::FieldCount] = { 1, 1, 1, 1, 0, 0, 1, 1, 1, 0 };
+
+    for (int field = 0; field < WeatherRecord::FieldCount; ++field) {
+        out.append(',');
+        if (random.bounded(100) >= missingPercent)
+            out.append(QByteArray::number(values[field], 'f', decimals[field]));
+    }
+    out.append('\n');
+}
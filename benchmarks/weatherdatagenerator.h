@@ -0,0 +1,27 @@
+#ifndef WEATHERDATAGENERATOR_H
+#define WEATHERDATAGENERATOR_H
+
+#include <QByteArray>
+#include <QRandomGenerator>
+#include <QStringList>
+
+// Meteostat-style CSV with one row per minute from 1970 on, the same seed always yields the same bytes.
+class WeatherDataGenerator
+{
+public:
+    explicit WeatherDataGenerator(quint32 seed = 1);
+
+    QByteArray header() const;
+    // Rows first .. first + count - 1, without header
+    QByteArray rows(qint64 first, qint64 count);
+    // Splits rows into files of at most rowsPerFile rows, returns their paths
+    QStringList writeFiles(const QString &directoryPath, qint64 count, qint64 rowsPerFile = 1000000);
+
+private:
+    void appendRow(QByteArray &out, qint64 row);
+
+    quint32 seed;
+    QRandomGenerator random;
+};
+
+#endif // WEATHERDATAGENERATOR_H
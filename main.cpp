@@ -1,59 +1,15 @@
 #include "mainwindow.h"
+#include "weatherdatabase.h"
 
 #include <QApplication>
 #include <QLocale>
 #include <QTranslator>
-#include <QSqlDatabase>
-#include <QSqlQuery>
-#include <QSqlError>
-
-bool initializeDatabase()
-{
-    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE");
-    db.setDatabaseName("weather.db");
-
-    if (!db.open()) {
-        qDebug() << "Error: Unable to open database!" << db.lastError().text();
-        return false;
-    } else {
-        qDebug() << "Database connected successfully.";
-    }
-
-    QSqlQuery query;
-    QString createTable = R"(
-        CREATE TABLE IF NOT EXISTS weather (
-            id INTEGER PRIMARY KEY AUTOINCREMENT,
-            date TEXT NOT NULL,
-            averageTemperature REAL,
-            minimumTemperature REAL,
-            maximunTemperature REAL,
-            precipitation REAL,
-            snow INTEGER,
-            windDirection INTEGER,
-            windSpeed REAL,
-            windPeakGust REAL,
-            airPressure REAL,
-            sunshineDuration INTEGER
-        )
-    )";
-
-    if (!query.exec(createTable)) {
-        qDebug() << "Error creating table:" << query.lastError().text();
-    } else {
-        qDebug() << "Table 'weather' created successfully.";
-    }
-
-    query.clear();
-    db.close();
-
-    return true;
-}
 
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
 
-    if (!initializeDatabase()) {
+    if (!WeatherDatabase::initialize("weather.db")) {
         return -1;
     }
 
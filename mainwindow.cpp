@@ -4,13 +4,16 @@
 #include "weathermodel.h"
 #include "weatherproxymodel.h"
 #include "querymodel.h"
+#include "queryworker.h"
+#include "weatherchartview.h"
+#include "weathertailwatcher.h"
 #include <QFileDialog>
 #include <QSqlDatabase>
 #include <QSqlQuery>
 #include <QSqlError>
-#include <QFile>
 #include <QMessageBox>
 #include <QDir>
+#include <algorithm>
 
 WeatherUtil *util = nullptr;
 WeatherModel *model = nullptr;
@@ -19,21 +22,53 @@ WeatherProxyModel *proxyModel = nullptr;
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
+    , queryRequest(0)
+    , queryRunning(false)
+    , chartView(nullptr)
 {
     ui->setupUi(this);
     util = new WeatherUtil(this);
     model = new WeatherModel(this);
     proxyModel = new WeatherProxyModel(this);
 
+    model->setDatabase(util->database());
     updateWeatherData();
+    connect(util, &WeatherUtil::loadingFinished, this, [this]() {
+        util->reloadStatistics();
+        updateWeatherData();
+        ui->statusbar->showMessage("Finished", 50);
+    });
     proxyModel->setSourceModel(model);
     ui->tableView->setModel(proxyModel);
     ui->tableView->setSortingEnabled(true);
     ui->tableView->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+
+    queryModel = new QueryModel(this);
+    queryProxyModel = new WeatherProxyModel(this);
+    queryProxyModel->setSourceModel(queryModel);
+    ui->queryTable->setModel(queryProxyModel);
+    ui->queryTable->setSortingEnabled(true);
+    ui->queryTable->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+    executeText = ui->pushButton->text();
+
+    // Ad-hoc queries run on their own connection so the window never blocks on them
+    queryThread = new QThread(this);
+    queryWorker = new QueryWorker(util->database().databaseName());
+    queryWorker->moveToThread(queryThread);
+    connect(queryThread, &QThread::finished, queryWorker, &QObject::deleteLater);
+    connect(queryWorker, &QueryWorker::batchReady, this, &MainWindow::queryBatchReady);
+    connect(queryWorker, &QueryWorker::finished, this, &MainWindow::queryFinished);
+    queryThread->start();
+
+    tailWatcher = new WeatherTailWatcher(util->database().databaseName(), this);
+    connect(tailWatcher, &WeatherTailWatcher::recordsAppended, this, &MainWindow::recordsAppended);
 }
 
 MainWindow::~MainWindow()
 {
+    queryWorker->cancel(queryRequest);
+    queryThread->quit();
+    queryThread->wait();
     delete ui;
 }
 
@@ -43,54 +78,131 @@ void MainWindow::on_actionLoad_triggered()
     dialog.setFileMode(QFileDialog::Directory);
     dialog.exec();
     ui->statusbar->showMessage("Loading...");
-    connect(util, &WeatherUtil::loadingFinished, this, [=]() {
-        updateWeatherData();
-        ui->statusbar->showMessage("Finished", 50);
-    });
     util->loadFromDirectoryAsync(dialog.directory().absolutePath());
 }
 
-void MainWindow::on_actionClear_triggered()
+// The table, chart and queries keep showing the current data until the rebuilt rows are copied over in one transaction
+void MainWindow::on_actionRebuild_triggered()
 {
-    QString dbPath = QDir::currentPath() + "/weather.db";
+    const QString directory = QFileDialog::getExistingDirectory(this, "Rebuild From Directory");
+    if (directory.isEmpty())
+        return;
 
-    if (!QFile::exists(dbPath)) {
-        QMessageBox::information(this, "Clear Database", "No database file found to delete.");
+    ui->statusbar->showMessage("Rebuilding...");
+    util->rebuildFromDirectoryAsync(directory);
+}
+
+void MainWindow::on_actionClear_triggered()
+{
+    if (util->weatherStatistics().rowCount() == 0) {
+        QMessageBox::information(this, "Clear Database", "The database is already empty.");
         return;
     }
 
-    QSqlDatabase::removeDatabase(QSqlDatabase::defaultConnection);
-
     QMessageBox::StandardButton reply;
     reply = QMessageBox::question(this, "Clear Database",
-                                  "Are you sure you want to delete the weather database?",
+                                  "Are you sure you want to delete all weather data?",
                                   QMessageBox::Yes | QMessageBox::No);
     if (reply == QMessageBox::Yes) {
-        if (QFile::remove(dbPath)) {
-            QMessageBox::information(this, "Clear Database", "Database deleted successfully.");
-        } else {
-            QMessageBox::critical(this, "Clear Database", "Failed to delete the database file.");
-        }
+        ui->actionWatch->setChecked(false);
+        ui->statusbar->showMessage("Clearing...");
+        util->rebuildFromDirectoryAsync(QString());
     }
-    updateWeatherData();
+}
+
+void MainWindow::on_actionWatch_toggled(bool checked)
+{
+    if (!checked) {
+        tailWatcher->stop();
+        ui->statusbar->showMessage("Stopped watching");
+        return;
+    }
+
+    const QString directory = QFileDialog::getExistingDirectory(this, "Watch Directory");
+    if (directory.isEmpty()) {
+        ui->actionWatch->setChecked(false);
+        return;
+    }
+
+    tailWatcher->watch(directory);
+    ui->statusbar->showMessage("Watching " + directory);
+}
+
+// Tail batches extend the table and chart in place instead of resetting them
+void MainWindow::recordsAppended(QVector<WeatherRecord> records)
+{
+    std::sort(records.begin(), records.end(), [](const WeatherRecord &left, const WeatherRecord &right) {
+        return left.timestamp < right.timestamp;
+    });
+
+    model->appendRecords(records);
+    if (util->appendRecords(records) && chartView)
+        chartView->appendRecords(records, util->weatherStore(), rollingOverlays());
+    else
+        updateChart();
+    updateStatistics();
 }
 
 void MainWindow::updateWeatherData()
 {
-    qDebug() << util->select("SELECT * FROM weather").size();
-    model->setWeatherList(util->select("SELECT * FROM weather"));
-    ui->lcd_totalElements->display(static_cast<int>(util->select("SELECT * FROM weather").size()));
+    util->reloadStore();
+    model->refresh();
+    updateStatistics();
+    updateChart();
+}
+
+void MainWindow::updateStatistics()
+{
+    ui->lcd_totalElements->display(static_cast<int>(util->weatherStatistics().rowCount()));
     ui->lcd_highestTemp->display(util->highestTemp());
     ui->lcd_avgTemp->display(util->avgTemp());
+}
 
-    QChartView *chartView = util->createTemperatureChart();
-    if(chartView)
+void MainWindow::updateChart()
+{
+    if (chartView) {
+        chartView->setStore(util->weatherStore(), util->lowestTemp(), util->highestTemp(), rollingOverlays());
+    } else if (!util->weatherStore().isEmpty()) {
+        chartView = new WeatherChartView(util->weatherStore(), util->lowestTemp(), util->highestTemp(), rollingOverlays());
         ui->chart->layout()->addWidget(chartView);
+    }
+}
+
+// Weekly, monthly and yearly moving averages of the daily mean temperature, plus 30-day extremes of
+// temperature, precipitation and gusts that start hidden and are switched on from the legend
+QVector<WeatherChartView::Overlay> MainWindow::rollingOverlays() const
+{
+    QVector<WeatherChartView::Overlay> overlays;
+    for (int days : { 7, 30, 365 }) {
+        const WeatherWindow &window = util->rollingWindow(WeatherStore::AverageTemperature, days);
+        overlays.append({ QString("%1-day Average").arg(days), window.means() });
+    }
+
+    const struct {
+        WeatherStore::Column column;
+        const char *name;
+        bool secondary;
+    } extremes[] = {
+        { WeatherStore::AverageTemperature, "Temp", false },
+        { WeatherStore::Precipitation, "Precipitation", true },
+        { WeatherStore::WindPeakGust, "Gust", true }
+    };
+    for (const auto &extreme : extremes) {
+        const WeatherWindow &window = util->rollingWindow(extreme.column, 30);
+        overlays.append({ QString("30-day Min %1").arg(extreme.name), window.minima(), WeatherPyramid::Minimum, extreme.secondary, false });
+        overlays.append({ QString("30-day Max %1").arg(extreme.name), window.maxima(), WeatherPyramid::Maximum, extreme.secondary, false });
+    }
+    return overlays;
 }
 
 
 void MainWindow::on_pushButton_clicked()
 {
+    if (queryRunning) {
+        queryWorker->cancel(queryRequest);
+        return;
+    }
+
     if(ui->lineEdit->text() == "" || ui->lineEdit->text() == nullptr){
         qWarning() << "No query provided";
         return;
@@ -103,13 +215,38 @@ void MainWindow::on_pushButton_clicked()
         return;
     }
 
-    QueryModel *modelQuery = new QueryModel(this);
-    WeatherProxyModel *proxyModelQuery = new WeatherProxyModel(this);
+    const int requestId = ++queryRequest;
+    queryRunning = true;
+    queryModel->clear();
+    ui->pushButton->setText(tr("Cancel"));
+    ui->statusbar->showMessage("Running query...");
 
-    modelQuery->setData(util->selectAsMap(text));
-    proxyModelQuery->setSourceModel(modelQuery);
-    ui->queryTable->setModel(proxyModelQuery);
-    ui->queryTable->setSortingEnabled(true);
-    ui->queryTable->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+    QueryWorker *worker = queryWorker;
+    QMetaObject::invokeMethod(worker, [worker, requestId, text]() {
+        worker->run(requestId, text);
+    }, Qt::QueuedConnection);
+}
+
+void MainWindow::queryBatchReady(int requestId, const QueryResult &batch)
+{
+    if (requestId == queryRequest)
+        queryModel->appendBatch(batch);
 }
 
+void MainWindow::queryFinished(int requestId, qint64 rows, qint64 elapsedMs, bool cancelled, const QString &error)
+{
+    if (requestId != queryRequest)
+        return;
+
+    queryRunning = false;
+    ui->pushButton->setText(executeText);
+
+    if (!error.isEmpty()) {
+        qWarning() << "Query failed:" << error;
+        ui->statusbar->showMessage("Query failed: " + error);
+    } else if (cancelled) {
+        ui->statusbar->showMessage(QString("Query cancelled after %1 rows, %2 ms").arg(rows).arg(elapsedMs));
+    } else {
+        ui->statusbar->showMessage(QString("%1 rows in %2 ms").arg(rows).arg(elapsedMs));
+    }
+}
@@ -2,6 +2,15 @@
 #define MAINWINDOW_H
 
 #include <QMainWindow>
+#include <QThread>
+#include "queryresult.h"
+#include "weatherchartview.h"
+#include "weatherrecord.h"
+
+class QueryModel;
+class QueryWorker;
+class WeatherProxyModel;
+class WeatherTailWatcher;
 
 QT_BEGIN_NAMESPACE
 namespace Ui {
@@ -19,12 +28,29 @@ public:
 
 private slots:
     void on_actionLoad_triggered();
+    void on_actionRebuild_triggered();
     void on_actionClear_triggered();
+    void on_actionWatch_toggled(bool checked);
+    void recordsAppended(QVector<WeatherRecord> records);
 
     void on_pushButton_clicked();
+    void queryBatchReady(int requestId, const QueryResult &batch);
+    void queryFinished(int requestId, qint64 rows, qint64 elapsedMs, bool cancelled, const QString &error);
 
 private:
     Ui::MainWindow *ui;
+    QueryModel *queryModel;
+    WeatherProxyModel *queryProxyModel;
+    QThread *queryThread;
+    QueryWorker *queryWorker;
+    int queryRequest;
+    bool queryRunning;
+    QString executeText;
+    WeatherChartView *chartView;
+    WeatherTailWatcher *tailWatcher;
     void updateWeatherData();
+    void updateStatistics();
+    void updateChart();
+    QVector<WeatherChartView::Overlay> rollingOverlays() const;
 };
 #endif // MAINWINDOW_H
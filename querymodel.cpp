@@ -1,42 +1,59 @@
 #include "querymodel.h"
+#include "weatherproxymodel.h"
 
 QueryModel::QueryModel(QObject *parent)
     : QAbstractTableModel(parent)
 {
 }
 
-void QueryModel::setData(const QVector<QMap<QString, QVariant>> &data)
+void QueryModel::setData(const QueryResult &result)
 {
     beginResetModel();
-    m_data = data;
+    m_result = result;
+    endResetModel();
+}
 
-    // Extract column names from the first row
-    m_columnNames.clear();
-    if (!m_data.isEmpty()) {
-        m_columnNames = m_data.first().keys();
+void QueryModel::appendBatch(const QueryResult &batch)
+{
+    if (m_result.columnCount() == 0) {
+        setData(batch);
+        return;
     }
 
-    endResetModel();
+    if (batch.rowCount() == 0)
+        return;
+
+    beginInsertRows(QModelIndex(), m_result.rowCount(), m_result.rowCount() + batch.rowCount() - 1);
+    m_result.append(batch);
+    endInsertRows();
+}
+
+void QueryModel::clear()
+{
+    setData(QueryResult());
+}
+
+const QueryResult &QueryModel::result() const
+{
+    return m_result;
 }
 
 int QueryModel::rowCount(const QModelIndex & /* parent */) const
 {
-    return m_data.size();
+    return m_result.rowCount();
 }
 
 int QueryModel::columnCount(const QModelIndex & /* parent */) const
 {
-    return m_columnNames.size();
+    return m_result.columnCount();
 }
 
 QVariant QueryModel::data(const QModelIndex &index, int role) const
 {
-    if (!index.isValid() || role != Qt::DisplayRole)
+    if (!index.isValid() || (role != Qt::DisplayRole && role != WeatherProxyModel::SortKeyRole))
         return QVariant();
 
-    const QMap<QString, QVariant> &row = m_data.at(index.row());
-    const QString &column = m_columnNames.at(index.column());
-    return row.value(column);
+    return m_result.value(index.row(), index.column());
 }
 
 QVariant QueryModel::headerData(int section, Qt::Orientation orientation, int role) const
@@ -44,8 +61,8 @@ QVariant QueryModel::headerData(int section, Qt::Orientation orientation, int ro
     if (role != Qt::DisplayRole)
         return QVariant();
 
-    if (orientation == Qt::Horizontal && section < m_columnNames.size()) {
-        return m_columnNames.at(section);
+    if (orientation == Qt::Horizontal && section < m_result.columnCount()) {
+        return m_result.columnName(section);
     } else if (orientation == Qt::Vertical) {
         return section + 1;  // Optional: show row numbers
     }
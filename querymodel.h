@@ -2,10 +2,7 @@
 #define QUERYMODEL_H
 
 #include <QAbstractTableModel>
-#include <QMap>
-#include <QVariant>
-#include <QString>
-#include <QVector>
+#include "queryresult.h"
 
 class QueryModel : public QAbstractTableModel
 {
@@ -14,7 +11,10 @@ class QueryModel : public QAbstractTableModel
 public:
     explicit QueryModel(QObject *parent = nullptr);
 
-    void setData(const QVector<QMap<QString, QVariant>> &data);
+    void setData(const QueryResult &result);
+    void appendBatch(const QueryResult &batch);
+    void clear();
+    const QueryResult &result() const;
 
     int rowCount(const QModelIndex &parent = QModelIndex()) const override;
     int columnCount(const QModelIndex &parent = QModelIndex()) const override;
@@ -23,8 +23,7 @@ public:
     QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
 
 private:
-    QVector<QMap<QString, QVariant>> m_data;
-    QStringList m_columnNames;
+    QueryResult m_result;
 };
 
 #endif // QUERYMODEL_H
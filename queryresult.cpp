@@ -0,0 +1,205 @@
+#include "queryresult.h"
+#include <limits>
+
+QueryResult::QueryResult()
+    : rows(0)
+{
+}
+
+QueryResult::QueryResult(const QSqlRecord &record)
+    : rows(0)
+{
+    columns.resize(record.count());
+    for (int column = 0; column < record.count(); ++column)
+        columns[column].name = record.fieldName(column);
+}
+
+QueryResult::QueryResult(const QStringList &columnNames)
+    : rows(0)
+{
+    columns.resize(columnNames.size());
+    for (int column = 0; column < columnNames.size(); ++column)
+        columns[column].name = columnNames.at(column);
+}
+
+void QueryResult::appendRow(const QSqlQuery &query)
+{
+    for (int column = 0; column < columns.size(); ++column)
+        columns[column].append(query.value(column), rows);
+    ++rows;
+}
+
+void QueryResult::appendRow(const QVariantList &values)
+{
+    for (int column = 0; column < columns.size(); ++column)
+        columns[column].append(values.value(column), rows);
+    ++rows;
+}
+
+void QueryResult::append(const QueryResult &other)
+{
+    if (columns.isEmpty()) {
+        *this = other;
+        return;
+    }
+
+    for (int row = 0; row < other.rows; ++row) {
+        for (int column = 0; column < columns.size() && column < other.columns.size(); ++column)
+            columns[column].append(other.columns.at(column).value(row), rows);
+        ++rows;
+    }
+}
+
+int QueryResult::rowCount() const
+{
+    return rows;
+}
+
+int QueryResult::columnCount() const
+{
+    return columns.size();
+}
+
+QString QueryResult::columnName(int column) const
+{
+    return columns.at(column).name;
+}
+
+QueryResult::ColumnType QueryResult::columnType(int column) const
+{
+    return columns.at(column).type;
+}
+
+bool QueryResult::isNull(int row, int column) const
+{
+    return columns.at(column).isNull(row);
+}
+
+QVariant QueryResult::value(int row, int column) const
+{
+    return columns.at(column).value(row);
+}
+
+QVector<double> QueryResult::numericColumn(int column, int first, int count) const
+{
+    const Column &source = columns.at(column);
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    first = qBound(0, first, rows);
+    const int last = count < 0 ? rows : qMin(rows, first + count);
+    QVector<double> values(last - first, nan);
+    double *value = values.data();
+
+    for (int row = first; row < last; ++row) {
+        if (source.isNull(row))
+            continue;
+        switch (source.type) {
+        case IntegerColumn: value[row - first] = double(source.integers.at(row)); break;
+        case RealColumn: value[row - first] = source.reals.at(row); break;
+        default: {
+            bool ok = false;
+            const double number = source.value(row).toDouble(&ok);
+            if (ok)
+                value[row - first] = number;
+            break;
+        }
+        }
+    }
+    return values;
+}
+
+QueryResult::ColumnType QueryResult::typeOf(const QVariant &value)
+{
+    if (value.isNull())
+        return NullColumn;
+
+    switch (value.userType()) {
+    case QMetaType::Bool:
+    case QMetaType::Int:
+    case QMetaType::UInt:
+    case QMetaType::LongLong:
+    case QMetaType::ULongLong:
+        return IntegerColumn;
+    case QMetaType::Float:
+    case QMetaType::Double:
+        return RealColumn;
+    case QMetaType::QString:
+        return TextColumn;
+    default:
+        return VariantColumn;
+    }
+}
+
+void QueryResult::Column::append(const QVariant &value, int row)
+{
+    const ColumnType valueType = typeOf(value);
+    if (row % 64 == 0)
+        nulls.append(0);
+    if (valueType == NullColumn)
+        nulls[row / 64] |= quint64(1) << (row % 64);
+
+    // SQLite types per value, so a column widens when a later row disagrees
+    if (valueType != NullColumn && valueType != type) {
+        if (type == NullColumn)
+            convertTo(valueType, row);
+        else if (type == IntegerColumn && valueType == RealColumn)
+            convertTo(RealColumn, row);
+        else if (type != RealColumn || valueType != IntegerColumn)
+            convertTo(VariantColumn, row);
+    }
+
+    switch (type) {
+    case NullColumn: break;
+    case IntegerColumn: integers.append(value.toLongLong()); break;
+    case RealColumn: reals.append(value.toDouble()); break;
+    case TextColumn: texts.append(value.toString()); break;
+    case VariantColumn: variants.append(value); break;
+    }
+}
+
+bool QueryResult::Column::isNull(int row) const
+{
+    return (nulls.at(row / 64) >> (row % 64)) & 1;
+}
+
+QVariant QueryResult::Column::value(int row) const
+{
+    if (isNull(row))
+        return QVariant();
+
+    switch (type) {
+    case IntegerColumn: return integers.at(row);
+    case RealColumn: return reals.at(row);
+    case TextColumn: return texts.at(row);
+    case VariantColumn: return variants.at(row);
+    default: return QVariant();
+    }
+}
+
+void QueryResult::Column::convertTo(ColumnType newType, int rows)
+{
+    switch (newType) {
+    case IntegerColumn:
+        integers.resize(rows);
+        break;
+    case RealColumn:
+        reals.reserve(rows);
+        for (int row = 0; row < rows; ++row)
+            reals.append(type == IntegerColumn ? double(integers.at(row)) : 0.0);
+        integers.clear();
+        break;
+    case TextColumn:
+        texts.resize(rows);
+        break;
+    case VariantColumn:
+        variants.reserve(rows);
+        for (int row = 0; row < rows; ++row)
+            variants.append(value(row));
+        integers.clear();
+        reals.clear();
+        texts.clear();
+        break;
+    default:
+        break;
+    }
+    type = newType;
+}
@@ -0,0 +1,66 @@
+#ifndef QUERYRESULT_H
+#define QUERYRESULT_H
+
+#include <QSqlQuery>
+#include <QSqlRecord>
+#include <QString>
+#include <QStringList>
+#include <QVariant>
+#include <QVector>
+
+// Result of an ad-hoc SELECT, stored column by column with one typed vector per column.
+class QueryResult
+{
+public:
+    enum ColumnType {
+        NullColumn,
+        IntegerColumn,
+        RealColumn,
+        TextColumn,
+        VariantColumn
+    };
+
+    QueryResult();
+    explicit QueryResult(const QSqlRecord &record);
+    explicit QueryResult(const QStringList &columnNames);
+
+    void appendRow(const QSqlQuery &query);
+    void appendRow(const QVariantList &values);
+    void append(const QueryResult &other);
+
+    int rowCount() const;
+    int columnCount() const;
+    QString columnName(int column) const;
+    ColumnType columnType(int column) const;
+    bool isNull(int row, int column) const;
+    QVariant value(int row, int column) const;
+    // count rows of the column from first on as doubles, NaN for NULL and for values that are not numbers;
+    // a negative count runs to the last row
+    QVector<double> numericColumn(int column, int first = 0, int count = -1) const;
+
+private:
+    struct Column
+    {
+        QString name;
+        ColumnType type = NullColumn;
+        QVector<quint64> nulls;
+        QVector<qint64> integers;
+        QVector<double> reals;
+        QVector<QString> texts;
+        QVector<QVariant> variants;
+
+        void append(const QVariant &value, int row);
+        bool isNull(int row) const;
+        QVariant value(int row) const;
+        void convertTo(ColumnType newType, int rows);
+    };
+
+    static ColumnType typeOf(const QVariant &value);
+
+    QVector<Column> columns;
+    int rows;
+};
+
+Q_DECLARE_METATYPE(QueryResult)
+
+#endif // QUERYRESULT_H
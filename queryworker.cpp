@@ -0,0 +1,234 @@
+#include "queryworker.h"
+#include "weatherdatabase.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QSqlDriver>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QUuid>
+
+#ifdef WEATHER_HAS_SQLITE3
+#include <sqlite3.h>
+#include <deque>
+#include <utility>
+#endif
+
+namespace {
+const int batchRows = 2048;
+const qint64 batchIntervalMs = 50;
+
+#ifdef WEATHER_HAS_SQLITE3
+// rolling_min(x) and rolling_max(x) OVER (ORDER BY time RANGE ...): SQLite's own MIN and MAX rescan the
+// whole frame for every row, these keep a monotonic deque and slide in linear time. AVG already does.
+struct RollingExtreme
+{
+    // Rows are numbered as they enter; the frame drops them again in the same order
+    std::deque<std::pair<qint64, double>> candidates;
+    qint64 entered = 0;
+    qint64 left = 0;
+};
+
+RollingExtreme *rollingState(sqlite3_context *context, bool create)
+{
+    auto **state = static_cast<RollingExtreme **>(sqlite3_aggregate_context(context, create ? sizeof(RollingExtreme *) : 0));
+    if (!state)
+        return nullptr;
+    if (!*state && create)
+        *state = new RollingExtreme;
+    return *state;
+}
+
+template<bool Minimum>
+void rollingStep(sqlite3_context *context, int, sqlite3_value **arguments)
+{
+    RollingExtreme *state = rollingState(context, true);
+    if (!state) {
+        sqlite3_result_error_nomem(context);
+        return;
+    }
+
+    const qint64 row = state->entered++;
+    if (sqlite3_value_type(arguments[0]) == SQLITE_NULL)
+        return;
+
+    const double value = sqlite3_value_double(arguments[0]);
+    while (!state->candidates.empty() && (Minimum ? state->candidates.back().second >= value : state->candidates.back().second <= value))
+        state->candidates.pop_back();
+    state->candidates.emplace_back(row, value);
+}
+
+void rollingInverse(sqlite3_context *context, int, sqlite3_value **)
+{
+    RollingExtreme *state = rollingState(context, false);
+    if (!state)
+        return;
+
+    ++state->left;
+    while (!state->candidates.empty() && state->candidates.front().first < state->left)
+        state->candidates.pop_front();
+}
+
+void rollingValue(sqlite3_context *context)
+{
+    RollingExtreme *state = rollingState(context, false);
+    if (!state || state->candidates.empty())
+        sqlite3_result_null(context);
+    else
+        sqlite3_result_double(context, state->candidates.front().second);
+}
+
+void rollingFinal(sqlite3_context *context)
+{
+    rollingValue(context);
+    delete rollingState(context, false);
+}
+
+bool registerRollingFunctions(sqlite3 *connection)
+{
+    const int flags = SQLITE_UTF8 | SQLITE_DETERMINISTIC;
+    if (sqlite3_create_window_function(connection, "rolling_min", 1, flags, nullptr, rollingStep<true>, rollingFinal,
+                                       rollingValue, rollingInverse, nullptr) != SQLITE_OK
+        || sqlite3_create_window_function(connection, "rolling_max", 1, flags, nullptr, rollingStep<false>, rollingFinal,
+                                          rollingValue, rollingInverse, nullptr) != SQLITE_OK) {
+        qWarning() << "Could not register rolling window functions:" << sqlite3_errmsg(connection);
+        return false;
+    }
+    return true;
+}
+
+// A bundled copy of the same release reports the same source id, so this cannot prove the build option,
+// but it does catch a WEATHER_SYSTEM_SQLITE build running against a Qt with another SQLite
+bool driverUsesLinkedSqlite(const QSqlDatabase &db)
+{
+    QSqlQuery query(db);
+    if (!query.exec("SELECT sqlite_source_id()") || !query.next())
+        return false;
+
+    const QString driverSource = query.value(0).toString();
+    if (driverSource == QLatin1String(sqlite3_sourceid()))
+        return true;
+    qWarning() << "Qt's SQLite driver runs" << driverSource << "but" << sqlite3_sourceid()
+               << "is linked, queries are only cancelled between rows";
+    return false;
+}
+#endif
+}
+
+QueryWorker::QueryWorker(const QString &databasePath, QObject *parent)
+    : QObject{parent}
+    , databasePath(databasePath)
+    , connectionName(QUuid::createUuid().toString())
+    , cancelledUpTo(-1)
+    , handle(nullptr)
+    , rollingFunctions(false)
+{
+    qRegisterMetaType<QueryResult>();
+}
+
+QueryWorker::~QueryWorker()
+{
+    if (db.isValid()) {
+        db.close();
+        db = QSqlDatabase();
+        QSqlDatabase::removeDatabase(connectionName);
+    }
+}
+
+void QueryWorker::cancel(int requestId)
+{
+    int current = cancelledUpTo.loadAcquire();
+    while (current < requestId) {
+        if (cancelledUpTo.testAndSetOrdered(current, requestId, current))
+            break;
+    }
+
+#ifdef WEATHER_HAS_SQLITE3
+    // Aborts a statement that is still computing its first row
+    if (void *connection = handle.loadAcquire())
+        sqlite3_interrupt(static_cast<sqlite3 *>(connection));
+#endif
+}
+
+void QueryWorker::run(int requestId, const QString &selectQuery)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    if (isCancelled(requestId)) {
+        emit finished(requestId, 0, timer.elapsed(), true, QString());
+        return;
+    }
+
+    if (!open()) {
+        emit finished(requestId, 0, timer.elapsed(), false, db.lastError().text());
+        return;
+    }
+
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    if (!query.exec(selectQuery)) {
+        QString error = query.lastError().text();
+        if (!rollingFunctions && error.contains("no such function: rolling_"))
+            error += tr(" (rolling_min and rolling_max need a build with WEATHER_SYSTEM_SQLITE, use MIN and MAX OVER instead)");
+        emit finished(requestId, 0, timer.elapsed(), isCancelled(requestId), error);
+        return;
+    }
+
+    const QSqlRecord record = query.record();
+    QueryResult batch(record);
+    qint64 rows = 0;
+    QElapsedTimer sinceBatch;
+    sinceBatch.start();
+
+    while (!isCancelled(requestId) && query.next()) {
+        batch.appendRow(query);
+        ++rows;
+
+        if (batch.rowCount() >= batchRows || sinceBatch.elapsed() >= batchIntervalMs) {
+            emit batchReady(requestId, batch);
+            batch = QueryResult(record);
+            sinceBatch.restart();
+        }
+    }
+
+    const bool cancelled = isCancelled(requestId);
+    const QString error = query.lastError().isValid() && !cancelled ? query.lastError().text() : QString();
+    query.finish();
+
+    // Always hand over the last batch so the columns show even for empty results
+    emit batchReady(requestId, batch);
+    emit finished(requestId, rows, timer.elapsed(), cancelled, error);
+}
+
+bool QueryWorker::open()
+{
+    if (db.isOpen())
+        return true;
+
+    if (!db.isValid()) {
+        db = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+        db.setDatabaseName(databasePath);
+        db.setConnectOptions(QString("QSQLITE_OPEN_READONLY;QSQLITE_BUSY_TIMEOUT=%1").arg(WeatherDatabase::busyTimeout));
+    }
+
+    if (!db.open()) {
+        qWarning() << "Query DB open failed:" << db.lastError().text();
+        return false;
+    }
+
+#ifdef WEATHER_HAS_SQLITE3
+    // The handle is only ever passed to the library that created it
+    const QVariant driverHandle = db.driver()->handle();
+    if (driverHandle.isValid() && qstrcmp(driverHandle.typeName(), "sqlite3*") == 0 && driverUsesLinkedSqlite(db)) {
+        handle.storeRelease(*static_cast<void *const *>(driverHandle.constData()));
+        rollingFunctions = registerRollingFunctions(static_cast<sqlite3 *>(handle.loadRelaxed()));
+    }
+#endif
+
+    return true;
+}
+
+bool QueryWorker::isCancelled(int requestId) const
+{
+    return requestId <= cancelledUpTo.loadAcquire();
+}
@@ -0,0 +1,41 @@
+#ifndef QUERYWORKER_H
+#define QUERYWORKER_H
+
+#include "queryresult.h"
+#include <QAtomicInt>
+#include <QAtomicPointer>
+#include <QObject>
+#include <QSqlDatabase>
+
+// Runs ad-hoc queries on its own read-only connection; lives in a worker thread.
+class QueryWorker : public QObject
+{
+    Q_OBJECT
+public:
+    explicit QueryWorker(const QString &databasePath, QObject *parent = nullptr);
+    ~QueryWorker();
+
+    // Thread-safe, cancels the given request and every earlier one
+    void cancel(int requestId);
+
+public slots:
+    void run(int requestId, const QString &selectQuery);
+
+signals:
+    void batchReady(int requestId, const QueryResult &batch);
+    void finished(int requestId, qint64 rows, qint64 elapsedMs, bool cancelled, const QString &error);
+
+private:
+    bool open();
+    bool isCancelled(int requestId) const;
+
+    QString databasePath;
+    QString connectionName;
+    QSqlDatabase db;
+    QAtomicInt cancelledUpTo;
+    QAtomicPointer<void> handle;
+    // rolling_min and rolling_max, registered only on the driver's own SQLite
+    bool rollingFunctions;
+};
+
+#endif // QUERYWORKER_H
@@ -0,0 +1,92 @@
+#include "weatherdatabase.h"
+#include "weatheringestor.h"
+#include <QFile>
+#include <QSqlQuery>
+#include <QTemporaryDir>
+#include <QtTest>
+
+namespace {
+const char *const header = "date,tavg,tmin,tmax,prcp,snow,wdir,wspd,wpgt,pres,tsun\n";
+}
+
+// Correctness checks for CSV ingest, run by CTest; timings live in the benchmarks
+class WeatherIngestTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+    void ingestWithoutFinalNewline();
+    void ingestGrownPartialLine();
+
+private:
+    void writeFile(const QByteArray &content, QIODevice::OpenMode mode = QIODevice::WriteOnly);
+    int lastSunshineDuration();
+
+    QTemporaryDir directory;
+    QString csv;
+    QString database;
+};
+
+void WeatherIngestTest::init()
+{
+    QVERIFY(directory.isValid());
+    csv = directory.filePath("weather.csv");
+    database = directory.filePath("weather.db");
+    WeatherDatabase::removeFiles(database);
+    QFile::remove(csv);
+    QVERIFY(WeatherDatabase::initialize(database));
+}
+
+void WeatherIngestTest::cleanup()
+{
+    WeatherDatabase::release(database);
+}
+
+void WeatherIngestTest::writeFile(const QByteArray &content, QIODevice::OpenMode mode)
+{
+    QFile file(csv);
+    QVERIFY(file.open(mode));
+    file.write(content);
+}
+
+int WeatherIngestTest::lastSunshineDuration()
+{
+    QSqlQuery query(WeatherDatabase::connection(database));
+    if (!query.exec("SELECT sunshineDuration FROM weather ORDER BY time DESC LIMIT 1") || !query.next())
+        return -1;
+    return query.value(0).toInt();
+}
+
+// A finished file whose last line has no newline is read in full, and not reopened afterwards
+void WeatherIngestTest::ingestWithoutFinalNewline()
+{
+    writeFile(QByteArray(header)
+              + "2024-01-01 00:00:00,5.6,3.6,8,2.9,0,201,15.5,51.8,1011.6,96\n"
+                "2024-01-02 00:00:00,6.8,4.3,9.7,14.4,0,182,18.7,43.9,1003.4,45");
+    QCOMPARE(WeatherIngestor(database).ingest({ csv }), qint64(2));
+    QCOMPARE(lastSunshineDuration(), 45);
+    QCOMPARE(WeatherIngestor(database).ingest({ csv }), qint64(0));
+}
+
+// While tailing, a last line caught half-written is read once it is complete, not kept as it was
+void WeatherIngestTest::ingestGrownPartialLine()
+{
+    writeFile(QByteArray(header)
+              + "2024-01-01 00:00:00,5.6,3.6,8,2.9,0,201,15.5,51.8,1011.6,96\n"
+                "2024-01-02 00:00:00,6.8,4.3,9.7,14.4,0,182,18.7,43.9,1003.4,4");
+    WeatherIngestor first(database);
+    first.setTailing(true);
+    QCOMPARE(first.ingest({ csv }), qint64(1));
+
+    writeFile("5\n", QIODevice::Append);
+    WeatherIngestor second(database);
+    second.setTailing(true);
+    QCOMPARE(second.ingest({ csv }), qint64(1));
+    QCOMPARE(lastSunshineDuration(), 45);
+}
+
+QTEST_GUILESS_MAIN(WeatherIngestTest)
+
+#include "weatheringesttest.moc"
@@ -3,27 +3,40 @@
 Weather::Weather()
 {}
 
+namespace {
+// Weather predates missing-value flags and keeps reporting gaps as 0
+float valueOrZero(const WeatherRecord &record, WeatherRecord::Field field)
+{
+    return record.isMissing(field) ? 0.0f : static_cast<float>(record.value(field));
+}
+}
+
+Weather::Weather(const WeatherRecord &record)
+    : date(record.dateTime())
+    , averageTemperature(valueOrZero(record, WeatherRecord::AverageTemperature))
+    , minimumTemperature(valueOrZero(record, WeatherRecord::MinimumTemperature))
+    , maximunTemperature(valueOrZero(record, WeatherRecord::MaximunTemperature))
+    , precipitation(valueOrZero(record, WeatherRecord::Precipitation))
+    , snow(record.values[WeatherRecord::Snow])
+    , windDirection(record.values[WeatherRecord::WindDirection])
+    , windSpeed(valueOrZero(record, WeatherRecord::WindSpeed))
+    , windPeakGust(valueOrZero(record, WeatherRecord::WindPeakGust))
+    , airPressure(valueOrZero(record, WeatherRecord::AirPressure))
+    , sunshineDuration(record.values[WeatherRecord::SunshineDuration])
+{}
+
 void Weather::parse(const QString &line)
 {
-    QStringList fields = line.split(',');
-    if(fields.size() != 11)
-        throw std::runtime_error("To many fields in line");
-
-    QString format = "yyyy-MM-dd HH:mm:ss";
-    date = QDateTime::fromString(fields[0], format);
-    averageTemperature =  fields[1].toFloat();
-    minimumTemperature = fields[2].toFloat();
-    maximunTemperature = fields[3].toFloat();
-    precipitation = fields[4].toFloat();
-    snow = fields[5].toInt();
-    windDirection = fields[6].toShort();
-    windSpeed = fields[7].toFloat();
-    windPeakGust = fields[8].toFloat();
-    airPressure = fields[9].toFloat();
-    sunshineDuration = fields[10].toInt();
-}
-
-void Weather::parse(QSqlQuery query)
+    const QByteArray utf8 = line.toUtf8();
+    parse(utf8.constData(), utf8.constData() + utf8.size());
+}
+
+void Weather::parse(const char *begin, const char *end)
+{
+    *this = Weather(WeatherRecord::fromCsv(begin, end));
+}
+
+void Weather::parse(const QSqlQuery &query)
 {
     QDateTime parseDate = QDateTime::fromString(query.value("date").toString(), Qt::ISODate);
     date = parseDate.isValid() ? parseDate : QDateTime();
@@ -3,13 +3,16 @@
 
 #include <QDateTime>
 #include <QSqlQuery>
+#include "weatherrecord.h"
 
 class Weather
 {
 public:
     explicit Weather();
+    explicit Weather(const WeatherRecord &record);
     void parse(const QString &line);
-    void parse(QSqlQuery query);
+    void parse(const char *begin, const char *end);
+    void parse(const QSqlQuery &query);
     QDateTime getDate() const;
     float getAverageTemperature() const;
     float getMinimumTemperature() const;
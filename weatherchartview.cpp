@@ -0,0 +1,346 @@
+#include "weatherchartview.h"
+#include <QKeyEvent>
+#include <QtCharts/QLegendMarker>
+#include <cmath>
+#include <QtConcurrent/QtConcurrent>
+
+WeatherChartView::Pyramids::Pyramids(const QVector<qint32> &days, const QVector<float> &average,
+                                     const QVector<float> &minimum, const QVector<float> &maximum, const QVector<Overlay> &overlays)
+    : average(days, average)
+    , minimum(days, minimum)
+    , maximum(days, maximum)
+{
+    // An overlay that does not match the rows is drawn empty rather than misaligned
+    for (const Overlay &overlay : overlays) {
+        const bool aligned = overlay.values.size() == days.size();
+        this->overlays.append(WeatherPyramid(days, aligned ? overlay.values : QVector<float>(days.size(), std::nanf(""))));
+        reductions.append(overlay.reduction);
+    }
+}
+
+void WeatherChartView::Pyramids::append(const Rows &rows)
+{
+    average.append(rows.days, rows.average);
+    minimum.append(rows.days, rows.minimum);
+    maximum.append(rows.days, rows.maximum);
+    for (qsizetype index = 0; index < overlays.size() && index < rows.overlays.size(); ++index)
+        overlays[index].append(rows.days, rows.overlays.at(index));
+}
+
+WeatherChartView::WeatherChartView(const WeatherStore &store, double lowest, double highest,
+                                   const QVector<Overlay> &overlays, QWidget *parent)
+    : QChartView(parent)
+    , refillPending(false)
+    , lastMSecs(0)
+{
+    avgTempSeries = new QLineSeries();
+    avgTempSeries->setName("Average Temp");
+
+    minTempSeries = new QLineSeries();
+    minTempSeries->setName("Minimum Temp");
+
+    maxTempSeries = new QLineSeries();
+    maxTempSeries->setName("Maximum Temp");
+
+    QChart *chart = new QChart();
+    chart->addSeries(avgTempSeries);
+    chart->addSeries(minTempSeries);
+    chart->addSeries(maxTempSeries);
+    chart->setTitle("Temperature Over Time");
+    chart->legend()->setAlignment(Qt::AlignBottom);
+
+    axisX = new QDateTimeAxis;
+    axisX->setFormat("yyyy-MM-dd");
+    axisX->setTitleText("Date");
+    chart->addAxis(axisX, Qt::AlignBottom);
+
+    avgTempSeries->attachAxis(axisX);
+    minTempSeries->attachAxis(axisX);
+    maxTempSeries->attachAxis(axisX);
+
+    axisY = new QValueAxis;
+    axisY->setTitleText("Temperature (°C)");
+    chart->addAxis(axisY, Qt::AlignLeft);
+
+    avgTempSeries->attachAxis(axisY);
+    minTempSeries->attachAxis(axisY);
+    maxTempSeries->attachAxis(axisY);
+
+    axisSecondary = new QValueAxis;
+    axisSecondary->setTitleText("Precipitation (mm), Wind (km/h)");
+    axisSecondary->setVisible(false);
+    chart->addAxis(axisSecondary, Qt::AlignRight);
+
+    setChart(chart);
+    setRenderHint(QPainter::Antialiasing);
+    setRubberBand(QChartView::HorizontalRubberBand);
+
+    connect(axisX, &QDateTimeAxis::rangeChanged, this, &WeatherChartView::scheduleRefill);
+    connect(&sampleWatcher, &QFutureWatcher<Samples>::finished, this, &WeatherChartView::applySamples);
+    connect(&pyramidWatcher, &QFutureWatcher<std::shared_ptr<Pyramids>>::finished, this, [this]() {
+        pyramids = pyramidWatcher.result();
+        updateSecondaryRange();
+        scheduleRefill();
+    });
+
+    setStore(store, lowest, highest, overlays);
+}
+
+void WeatherChartView::setStore(const WeatherStore &store, double lowest, double highest, const QVector<Overlay> &overlays)
+{
+    updateOverlaySeries(overlays);
+    rebuildPyramids(store, overlays);
+
+    axisY->setRange(lowest, highest);
+    lastMSecs = store.isEmpty() ? 0 : WeatherStore::toMSecsSinceEpoch(store.day(store.size() - 1));
+    if (!store.isEmpty()) {
+        axisX->setRange(QDateTime::fromMSecsSinceEpoch(WeatherStore::toMSecsSinceEpoch(store.day(0))),
+                        QDateTime::fromMSecsSinceEpoch(lastMSecs));
+    }
+}
+
+void WeatherChartView::appendRecords(const QVector<WeatherRecord> &records, const WeatherStore &store,
+                                     const QVector<Overlay> &overlays)
+{
+    if (records.isEmpty())
+        return;
+
+    // The series are only ever filled from the pyramids, the new rows just widen the axis ranges
+    double lowest = axisY->min();
+    double highest = axisY->max();
+    for (const WeatherRecord &record : records) {
+        for (WeatherRecord::Field field : { WeatherRecord::AverageTemperature, WeatherRecord::MinimumTemperature,
+                                            WeatherRecord::MaximunTemperature }) {
+            if (record.isMissing(field))
+                continue;
+            const double value = record.value(field);
+            lowest = qMin(lowest, value);
+            highest = qMax(highest, value);
+        }
+    }
+    axisY->setRange(lowest, highest);
+
+    // A view that shows the latest data keeps following it
+    const bool following = axisX->max().toMSecsSinceEpoch() >= lastMSecs;
+    lastMSecs = qMax(lastMSecs, WeatherStore::toMSecsSinceEpoch(records.last().epochDay()));
+    updateOverlaySeries(overlays);
+    growPyramids(store, overlays);
+    if (following)
+        axisX->setMax(QDateTime::fromMSecsSinceEpoch(lastMSecs));
+}
+
+void WeatherChartView::rebuildPyramids(const WeatherStore &store, const QVector<Overlay> &overlays)
+{
+    pendingRows = Rows();
+
+    // The columns are implicitly shared, so the pyramids build off the GUI thread from a stable copy
+    const QVector<qint32> days = store.dayData();
+    const QVector<float> average = store.columnData(WeatherStore::AverageTemperature);
+    const QVector<float> minimum = store.columnData(WeatherStore::MinimumTemperature);
+    const QVector<float> maximum = store.columnData(WeatherStore::MaximunTemperature);
+    pyramidWatcher.setFuture(QtConcurrent::run([=]() -> std::shared_ptr<Pyramids> {
+        return std::make_shared<Pyramids>(days, average, minimum, maximum, overlays);
+    }));
+}
+
+// Only the store's tail is copied, the rows already in the pyramids stay where they are
+void WeatherChartView::growPyramids(const WeatherStore &store, const QVector<Overlay> &overlays)
+{
+    const qsizetype known = (pyramids ? pyramids->average.size() : 0) + pendingRows.days.size();
+    if (!pyramids || pyramidWatcher.isRunning() || pyramids->overlays.size() != overlays.size() || store.size() < known) {
+        rebuildPyramids(store, overlays);
+        return;
+    }
+
+    const qsizetype added = store.size() - known;
+    pendingRows.days += store.dayData().mid(known);
+    pendingRows.average += store.columnData(WeatherStore::AverageTemperature).mid(known);
+    pendingRows.minimum += store.columnData(WeatherStore::MinimumTemperature).mid(known);
+    pendingRows.maximum += store.columnData(WeatherStore::MaximunTemperature).mid(known);
+    pendingRows.overlays.resize(overlays.size());
+    for (qsizetype index = 0; index < overlays.size(); ++index) {
+        const QVector<float> &values = overlays.at(index).values;
+        pendingRows.overlays[index] += values.size() == store.size() ? values.mid(known) : QVector<float>(added, std::nanf(""));
+    }
+    applyPendingRows();
+}
+
+void WeatherChartView::applyPendingRows()
+{
+    // A running sampler reads the pyramids, the rows wait for it to finish
+    if (pendingRows.days.isEmpty() || sampleWatcher.isRunning())
+        return;
+
+    pyramids->append(pendingRows);
+    pendingRows = Rows();
+    updateSecondaryRange();
+    scheduleRefill();
+}
+
+void WeatherChartView::updateOverlaySeries(const QVector<Overlay> &overlays)
+{
+    while (overlaySeries.size() > overlays.size()) {
+        QLineSeries *series = overlaySeries.takeLast();
+        chart()->removeSeries(series);
+        delete series;
+    }
+
+    while (overlaySeries.size() < overlays.size()) {
+        const Overlay &overlay = overlays.at(overlaySeries.size());
+        QLineSeries *series = new QLineSeries();
+        chart()->addSeries(series);
+        series->attachAxis(axisX);
+        series->attachAxis(overlay.secondary ? axisSecondary : axisY);
+        overlaySeries.append(series);
+
+        const QList<QLegendMarker *> markers = chart()->legend()->markers(series);
+        for (QLegendMarker *marker : markers) {
+            connect(marker, &QLegendMarker::clicked, this, [this, series]() {
+                setOverlayVisible(series, !series->isVisible());
+            });
+        }
+        setOverlayVisible(series, overlay.visible);
+    }
+
+    for (qsizetype index = 0; index < overlays.size(); ++index)
+        overlaySeries.at(index)->setName(overlays.at(index).name);
+}
+
+void WeatherChartView::setOverlayVisible(QLineSeries *series, bool visible)
+{
+    series->setVisible(visible);
+
+    // A hidden line keeps a dimmed legend entry to switch it back on
+    QColor color = chart()->legend()->labelColor();
+    color.setAlphaF(visible ? 1.0 : 0.4);
+    const QList<QLegendMarker *> markers = chart()->legend()->markers(series);
+    for (QLegendMarker *marker : markers) {
+        marker->setVisible(true);
+        marker->setLabelBrush(color);
+    }
+
+    updateSecondaryRange();
+    scheduleRefill();
+}
+
+// The right-hand axis spans the visible secondary overlays and is hidden without them
+void WeatherChartView::updateSecondaryRange()
+{
+    bool shown = false;
+    double lowest = 0.0;
+    double highest = 1.0;
+    for (qsizetype index = 0; index < overlaySeries.size(); ++index) {
+        QLineSeries *series = overlaySeries.at(index);
+        if (!series->isVisible() || !series->attachedAxes().contains(axisSecondary))
+            continue;
+
+        shown = true;
+        if (pyramids && index < pyramids->overlays.size()) {
+            const QPair<double, double> range = pyramids->overlays.at(index).range();
+            if (!std::isnan(range.first)) {
+                lowest = qMin(lowest, range.first);
+                highest = qMax(highest, range.second);
+            }
+        }
+    }
+
+    axisSecondary->setVisible(shown);
+    if (shown)
+        axisSecondary->setRange(lowest, highest);
+}
+
+void WeatherChartView::resizeEvent(QResizeEvent *event)
+{
+    QChartView::resizeEvent(event);
+    scheduleRefill();
+}
+
+void WeatherChartView::keyPressEvent(QKeyEvent *event)
+{
+    switch (event->key()) {
+    case Qt::Key_Plus:
+        zoom(0.5);
+        break;
+    case Qt::Key_Minus:
+        zoom(2.0);
+        break;
+    case Qt::Key_Left:
+        chart()->scroll(-width() / 10.0, 0);
+        break;
+    case Qt::Key_Right:
+        chart()->scroll(width() / 10.0, 0);
+        break;
+    default:
+        QChartView::keyPressEvent(event);
+        break;
+    }
+}
+
+void WeatherChartView::zoom(double factor)
+{
+    const qint64 from = axisX->min().toMSecsSinceEpoch();
+    const qint64 to = axisX->max().toMSecsSinceEpoch();
+    const qint64 center = from + (to - from) / 2;
+    const qint64 halfSpan = static_cast<qint64>((to - from) / 2 * factor);
+    axisX->setRange(QDateTime::fromMSecsSinceEpoch(center - halfSpan),
+                    QDateTime::fromMSecsSinceEpoch(center + halfSpan));
+}
+
+void WeatherChartView::scheduleRefill()
+{
+    // A rebuild in flight refills once it lands
+    if (!pyramids || pyramidWatcher.isRunning())
+        return;
+
+    if (sampleWatcher.isRunning()) {
+        refillPending = true;
+        return;
+    }
+
+    const qint32 fromDay = WeatherStore::toEpochDay(axisX->min().date());
+    const qint32 toDay = WeatherStore::toEpochDay(axisX->max().date());
+    const int maxPoints = qMax(1, static_cast<int>(chart()->plotArea().width()));
+    const std::shared_ptr<const Pyramids> current = pyramids;
+    QVector<bool> shown;
+    for (QLineSeries *series : std::as_const(overlaySeries))
+        shown.append(series->isVisible());
+
+    sampleWatcher.setFuture(QtConcurrent::run([=]() {
+        // Pad by a row on each side so the lines run off the plot edges
+        QPair<qsizetype, qsizetype> rows = current->average.rowRange(fromDay, toDay);
+        rows.first = qMax<qsizetype>(rows.first - 1, 0);
+        rows.second = qMin(rows.second + 1, current->average.size());
+
+        Samples samples;
+        samples.average = current->average.sample(rows.first, rows.second, maxPoints, WeatherPyramid::Mean);
+        samples.minimum = current->minimum.sample(rows.first, rows.second, maxPoints, WeatherPyramid::Minimum);
+        samples.maximum = current->maximum.sample(rows.first, rows.second, maxPoints, WeatherPyramid::Maximum);
+        // Hidden overlays are not sampled until they are switched on
+        for (qsizetype index = 0; index < current->overlays.size(); ++index) {
+            if (index < shown.size() && shown.at(index))
+                samples.overlays.append(current->overlays.at(index).sample(rows.first, rows.second, maxPoints, current->reductions.at(index)));
+            else
+                samples.overlays.append(QVector<QPointF>());
+        }
+        return samples;
+    }));
+}
+
+void WeatherChartView::applySamples()
+{
+    const Samples samples = sampleWatcher.result();
+    avgTempSeries->replace(samples.average);
+    minTempSeries->replace(samples.minimum);
+    maxTempSeries->replace(samples.maximum);
+    for (qsizetype index = 0; index < samples.overlays.size() && index < overlaySeries.size(); ++index)
+        overlaySeries.at(index)->replace(samples.overlays.at(index));
+
+    // Rows that arrived during the sampling go in now, their refill also covers a pending range change
+    if (!pendingRows.days.isEmpty()) {
+        refillPending = false;
+        applyPendingRows();
+    } else if (refillPending) {
+        refillPending = false;
+        scheduleRefill();
+    }
+}
@@ -0,0 +1,100 @@
+#ifndef WEATHERCHARTVIEW_H
+#define WEATHERCHARTVIEW_H
+
+#include "weatherpyramid.h"
+#include <QFutureWatcher>
+#include <QtCharts/QChartView>
+#include <QtCharts/QDateTimeAxis>
+#include <QtCharts/QLineSeries>
+#include <QtCharts/QValueAxis>
+#include <memory>
+
+// Temperature chart that only ever holds about one point per pixel.
+class WeatherChartView : public QChartView
+{
+    Q_OBJECT
+public:
+    // A line drawn over the temperatures, such as a moving average, with one value per store row.
+    // Axis and initial visibility are taken when the overlay first appears, the legend toggles it after that.
+    struct Overlay
+    {
+        QString name;
+        QVector<float> values;
+        WeatherPyramid::Reduction reduction = WeatherPyramid::Mean;
+        // Against the right-hand axis, for precipitation and wind
+        bool secondary = false;
+        bool visible = true;
+    };
+
+    WeatherChartView(const WeatherStore &store, double lowest, double highest,
+                     const QVector<Overlay> &overlays = QVector<Overlay>(), QWidget *parent = nullptr);
+
+    void setStore(const WeatherStore &store, double lowest, double highest, const QVector<Overlay> &overlays = QVector<Overlay>());
+    // The records must already be appended to the store, in date order, and the overlays extended to match
+    void appendRecords(const QVector<WeatherRecord> &records, const WeatherStore &store, const QVector<Overlay> &overlays);
+
+protected:
+    void resizeEvent(QResizeEvent *event) override;
+    void keyPressEvent(QKeyEvent *event) override;
+
+private slots:
+    void scheduleRefill();
+    void applySamples();
+
+private:
+    // Rows appended to the store that the pyramids do not hold yet
+    struct Rows
+    {
+        QVector<qint32> days;
+        QVector<float> average;
+        QVector<float> minimum;
+        QVector<float> maximum;
+        QVector<QVector<float>> overlays;
+    };
+
+    struct Pyramids
+    {
+        Pyramids(const QVector<qint32> &days, const QVector<float> &average,
+                 const QVector<float> &minimum, const QVector<float> &maximum, const QVector<Overlay> &overlays);
+        void append(const Rows &rows);
+        WeatherPyramid average;
+        WeatherPyramid minimum;
+        WeatherPyramid maximum;
+        QVector<WeatherPyramid> overlays;
+        QVector<WeatherPyramid::Reduction> reductions;
+    };
+
+    struct Samples
+    {
+        QVector<QPointF> average;
+        QVector<QPointF> minimum;
+        QVector<QPointF> maximum;
+        QVector<QVector<QPointF>> overlays;
+    };
+
+    void zoom(double factor);
+    void rebuildPyramids(const WeatherStore &store, const QVector<Overlay> &overlays);
+    void growPyramids(const WeatherStore &store, const QVector<Overlay> &overlays);
+    void applyPendingRows();
+    void updateOverlaySeries(const QVector<Overlay> &overlays);
+    void setOverlayVisible(QLineSeries *series, bool visible);
+    void updateSecondaryRange();
+
+    // Grown in place on the GUI thread, only while no sampler reads them
+    std::shared_ptr<Pyramids> pyramids;
+    QFutureWatcher<std::shared_ptr<Pyramids>> pyramidWatcher;
+    Rows pendingRows;
+    QFutureWatcher<Samples> sampleWatcher;
+    bool refillPending;
+
+    QLineSeries *avgTempSeries;
+    QLineSeries *minTempSeries;
+    QLineSeries *maxTempSeries;
+    QVector<QLineSeries *> overlaySeries;
+    QDateTimeAxis *axisX;
+    QValueAxis *axisY;
+    QValueAxis *axisSecondary;
+    qint64 lastMSecs;
+};
+
+#endif // WEATHERCHARTVIEW_H
@@ -0,0 +1,284 @@
+#include "weatherdatabase.h"
+#include "weatheringestor.h"
+#include "weatherutil.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDate>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTextStream>
+
+namespace {
+QTextStream &err()
+{
+    static QTextStream stream(stderr);
+    return stream;
+}
+
+QString csvField(const QVariant &value)
+{
+    if (value.isNull())
+        return QString();
+
+    QString text = value.toString();
+    if (text.contains(',') || text.contains('"') || text.contains('\n'))
+        text = '"' + text.replace('"', "\"\"") + '"';
+    return text;
+}
+
+void writeCsv(QTextStream &out, const QueryResult &result)
+{
+    QStringList fields;
+    for (int column = 0; column < result.columnCount(); ++column)
+        fields << csvField(result.columnName(column));
+    out << fields.join(',') << '\n';
+
+    for (int row = 0; row < result.rowCount(); ++row) {
+        fields.clear();
+        for (int column = 0; column < result.columnCount(); ++column)
+            fields << csvField(result.value(row, column));
+        out << fields.join(',') << '\n';
+    }
+}
+
+// Wall-clock seconds at the start of an ISO date, an empty text falls back to the day of fallback
+bool dayStart(const QString &text, qint64 fallback, qint64 &start)
+{
+    if (text.isEmpty()) {
+        start = qint64(WeatherRecord::dayOf(fallback)) * 86400;
+        return true;
+    }
+
+    const QDate date = QDate::fromString(text, Qt::ISODate);
+    start = WeatherRecord::daysFromCivil(date.year(), date.month(), date.day()) * 86400;
+    return date.isValid();
+}
+
+int ingest(const QString &databasePath, const QString &directoryPath)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    const QStringList files = WeatherIngestor::csvFiles(directoryPath);
+    if (files.isEmpty()) {
+        err() << "No CSV files in " << directoryPath << Qt::endl;
+        return 1;
+    }
+
+    WeatherIngestor ingestor(databasePath);
+    const qint64 inserted = ingestor.ingest(files);
+    err() << "Ingested " << inserted << " new rows from " << files.size() << " files in "
+          << timer.elapsed() << " ms" << Qt::endl;
+    return 0;
+}
+
+// Readers of the database keep the old rows until the new ones are swapped in, for scheduled full reloads
+int rebuild(const QString &databasePath, const QString &directoryPath)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    const QStringList files = WeatherIngestor::csvFiles(directoryPath);
+    if (files.isEmpty()) {
+        err() << "No CSV files in " << directoryPath << Qt::endl;
+        return 1;
+    }
+
+    if (!WeatherIngestor(databasePath).rebuild(files)) {
+        err() << "Rebuild failed, " << databasePath << " is unchanged" << Qt::endl;
+        return 1;
+    }
+    err() << "Rebuilt from " << files.size() << " files in " << timer.elapsed() << " ms" << Qt::endl;
+    return 0;
+}
+
+int query(WeatherUtil &util, const QString &sql, const QString &outputPath)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    const QueryResult result = util.selectResult(sql);
+    const qint64 queryTime = timer.restart();
+    if (result.columnCount() == 0) {
+        err() << "Query returned no columns" << Qt::endl;
+        return 1;
+    }
+
+    QFile file(outputPath);
+    if (outputPath.isEmpty() ? !file.open(stdout, QIODevice::WriteOnly) : !file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        err() << "Could not write " << outputPath << ": " << file.errorString() << Qt::endl;
+        return 1;
+    }
+    QTextStream out(&file);
+    writeCsv(out, result);
+    out.flush();
+
+    err() << result.rowCount() << " rows, query " << queryTime << " ms, export " << timer.elapsed() << " ms" << Qt::endl;
+    return 0;
+}
+
+// Whole days from the first to the last date in [first, end), returns an exit code
+int dayRange(WeatherUtil &util, const QString &from, const QString &to, qint64 &first, qint64 &end)
+{
+    // An open end is bounded by the stored rows so the rollup tiling stays short
+    const QueryResult extent = util.run(WeatherQuery()
+                                            .aggregate(WeatherQuery::Minimum, WeatherQuery::Time)
+                                            .aggregate(WeatherQuery::Maximum, WeatherQuery::Time));
+    if (extent.rowCount() == 0 || extent.isNull(0, 0)) {
+        err() << "The database is empty" << Qt::endl;
+        return 1;
+    }
+    qint64 last = 0;
+    if (!dayStart(from, extent.value(0, 0).toLongLong(), first) || !dayStart(to, extent.value(0, 1).toLongLong(), last)) {
+        err() << "Dates must be given as yyyy-MM-dd" << Qt::endl;
+        return 2;
+    }
+    end = last + 86400;
+    return 0;
+}
+
+int summarize(WeatherUtil &util, const QString &from, const QString &to)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    // Without a range the running totals answer, a range is tiled from the rollup tables
+    WeatherStatistics statistics;
+    if (from.isEmpty() && to.isEmpty()) {
+        if (!util.reloadStatistics())
+            return 1;
+        statistics = util.weatherStatistics();
+    } else {
+        qint64 first = 0;
+        qint64 end = 0;
+        if (const int status = dayRange(util, from, to, first, end))
+            return status;
+        statistics = util.rollupAggregate(first, end);
+    }
+
+    QTextStream out(stdout);
+    out << "column,count,mean,minimum,maximum\n";
+    for (int column = 0; column < WeatherStore::ColumnCount; ++column) {
+        const WeatherStatistics::ColumnStatistics &values = statistics.column(static_cast<WeatherStore::Column>(column));
+        out << WeatherStore::columnName(static_cast<WeatherStore::Column>(column)) << ',' << values.count;
+        if (values.count > 0)
+            out << ',' << values.mean() << ',' << values.minimum << ',' << values.maximum;
+        else
+            out << ",,,";
+        out << '\n';
+    }
+    out.flush();
+
+    err() << statistics.rowCount() << " rows summarized in " << timer.elapsed() << " ms" << Qt::endl;
+    return 0;
+}
+
+// Approximate P5/P50/P95/P99 from the stored sketches, for the whole range or per month or year
+int percentiles(WeatherUtil &util, const QString &from, const QString &to, const QString &by)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    if (!by.isEmpty() && by != "month" && by != "year") {
+        err() << "--by takes month or year" << Qt::endl;
+        return 2;
+    }
+
+    qint64 first = 0;
+    qint64 end = 0;
+    if (const int status = dayRange(util, from, to, first, end))
+        return status;
+
+    static const double quantiles[] = { 0.05, 0.5, 0.95, 0.99 };
+    QTextStream out(stdout);
+    auto writeRow = [&out](const WeatherSketch &sketch) {
+        out << WeatherStore::columnName(sketch.column()) << ',' << sketch.count();
+        for (double q : quantiles) {
+            out << ',';
+            if (sketch.count() > 0)
+                out << sketch.quantile(q);
+        }
+        out << '\n';
+    };
+
+    if (by.isEmpty()) {
+        out << "column,count,p5,p50,p95,p99\n";
+        for (WeatherStore::Column column : WeatherSketches::columns)
+            writeRow(util.sketch(column, first, end));
+    } else {
+        const WeatherRollups::Level level = by == "year" ? WeatherRollups::Year : WeatherRollups::Month;
+        out << "start,column,count,p5,p50,p95,p99\n";
+        for (WeatherStore::Column column : WeatherSketches::columns) {
+            const QVector<WeatherSketches::Bucket> buckets = util.sketchSeries(column, level, first, end);
+            for (const WeatherSketches::Bucket &bucket : buckets) {
+                out << WeatherStore::fromEpochDay(WeatherRecord::dayOf(bucket.start)).toString(Qt::ISODate) << ',';
+                writeRow(bucket.sketch);
+            }
+        }
+    }
+    out.flush();
+
+    err() << "Percentiles in " << timer.elapsed() << " ms" << Qt::endl;
+    return 0;
+}
+}
+
+// Headless entry point for scripted ingest and queries, shares the engine with the GUI.
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("weather-cli");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Ingest Meteostat CSV files and query the weather database.\n\n"
+                                     "Commands:\n"
+                                     "  ingest <directory>  Add new and grown CSV files\n"
+                                     "  rebuild <directory> Replace the contents with these CSV files\n"
+                                     "  query <sql>         Run a SELECT and export it as CSV\n"
+                                     "  stats               Count, mean, minimum and maximum per column\n"
+                                     "  percentiles         P5, P50, P95 and P99 of temperature, wind speed and precipitation");
+    parser.addHelpOption();
+    const QCommandLineOption databaseOption({ "d", "database" }, "SQLite database file.", "path", "weather.db");
+    const QCommandLineOption outputOption({ "o", "output" }, "Write query results to a file instead of stdout.", "file");
+    const QCommandLineOption fromOption("from", "First day for stats and percentiles.", "yyyy-MM-dd");
+    const QCommandLineOption toOption("to", "Last day for stats and percentiles.", "yyyy-MM-dd");
+    const QCommandLineOption byOption("by", "Percentiles per month or year instead of over the whole range.", "month|year");
+    parser.addOptions({ databaseOption, outputOption, fromOption, toOption, byOption });
+    parser.addPositionalArgument("command", "ingest, rebuild, query, stats or percentiles.");
+    parser.addPositionalArgument("argument", "Directory for ingest and rebuild, SQL for query.", "[argument]");
+    parser.process(app);
+
+    const QStringList arguments = parser.positionalArguments();
+    const QString command = arguments.value(0);
+    const QString databasePath = parser.value(databaseOption);
+
+    QElapsedTimer timer;
+    timer.start();
+    if (!WeatherDatabase::initialize(databasePath))
+        return 1;
+    err() << "Opened " << databasePath << " in " << timer.elapsed() << " ms" << Qt::endl;
+
+    if (command == "ingest" && arguments.size() == 2)
+        return ingest(databasePath, arguments.at(1));
+
+    if (command == "rebuild" && arguments.size() == 2)
+        return rebuild(databasePath, arguments.at(1));
+
+    if (command == "query" && arguments.size() == 2) {
+        WeatherUtil util(databasePath);
+        return query(util, arguments.at(1), parser.value(outputOption));
+    }
+
+    if (command == "stats" && arguments.size() == 1) {
+        WeatherUtil util(databasePath);
+        return summarize(util, parser.value(fromOption), parser.value(toOption));
+    }
+
+    if (command == "percentiles" && arguments.size() == 1) {
+        WeatherUtil util(databasePath);
+        return percentiles(util, parser.value(fromOption), parser.value(toOption), parser.value(byOption));
+    }
+
+    parser.showHelp(2);
+}
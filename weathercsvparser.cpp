@@ -0,0 +1,140 @@
+#include "weathercsvparser.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+WeatherCsvParser::WeatherCsvParser(const QString &filePath)
+    : file(filePath)
+    , begin(nullptr)
+    , cursor(nullptr)
+    , end(nullptr)
+    , lineBegin(nullptr)
+    , holdPartialLine(false)
+{
+}
+
+WeatherCsvParser::WeatherCsvParser(const WeatherCsvParser &source, qint64 from, qint64 to)
+    : begin(source.begin)
+    , cursor(source.begin + from)
+    , end(source.begin + to)
+    , lineBegin(cursor)
+    , holdPartialLine(source.holdPartialLine)
+{
+}
+
+bool WeatherCsvParser::open()
+{
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    if (file.size() == 0)
+        return true;
+
+    const uchar *data = file.map(0, file.size());
+    if (!data)
+        return false;
+
+    begin = cursor = reinterpret_cast<const char *>(data);
+    end = cursor + file.size();
+
+    if (end - cursor >= 3 && std::memcmp(cursor, "\xEF\xBB\xBF", 3) == 0)
+        cursor += 3;
+
+    // Skip the header line
+    const void *newline = std::memchr(cursor, '\n', end - cursor);
+    cursor = newline ? static_cast<const char *>(newline) + 1 : end;
+    lineBegin = cursor;
+
+    return true;
+}
+
+void WeatherCsvParser::setHoldPartialLine(bool hold)
+{
+    holdPartialLine = hold;
+}
+
+bool WeatherCsvParser::seek(qint64 offset)
+{
+    if (offset < 0 || offset > end - begin)
+        return false;
+
+    // Never move back into the BOM and header line
+    if (begin + offset > cursor)
+        cursor = lineBegin = begin + offset;
+    return true;
+}
+
+bool WeatherCsvParser::atEnd() const
+{
+    return cursor == end;
+}
+
+bool WeatherCsvParser::readNext(WeatherRecord &record)
+{
+    while (cursor != end) {
+        const void *newline = std::memchr(cursor, '\n', end - cursor);
+        // A last line without its newline may still be being written when the file is tailed
+        if (!newline && holdPartialLine) {
+            cursor = end;
+            return false;
+        }
+
+        lineBegin = cursor;
+        const char *lineEnd = newline ? static_cast<const char *>(newline) : end;
+        cursor = newline ? lineEnd + 1 : end;
+
+        if (lineEnd != lineBegin && lineEnd[-1] == '\r')
+            --lineEnd;
+        if (lineEnd == lineBegin)
+            continue;
+
+        try {
+            record = WeatherRecord::fromCsv(lineBegin, lineEnd);
+        } catch (const std::runtime_error &e) {
+            throw std::runtime_error(std::string(e.what()) + ' ' + std::to_string(lineNumber()));
+        }
+        return true;
+    }
+    return false;
+}
+
+int WeatherCsvParser::lineNumber() const
+{
+    return static_cast<int>(std::count(begin, lineBegin, '\n')) + 1;
+}
+
+qint64 WeatherCsvParser::size() const
+{
+    return end - begin;
+}
+
+QByteArray WeatherCsvParser::content(qint64 length) const
+{
+    return QByteArray::fromRawData(begin, static_cast<qsizetype>(qBound<qint64>(0, length, end - begin)));
+}
+
+qint64 WeatherCsvParser::completeLength() const
+{
+    const char *last = end;
+    while (holdPartialLine && last != begin && last[-1] != '\n')
+        --last;
+    return last - begin;
+}
+
+QVector<qint64> WeatherCsvParser::chunkOffsets(qint64 chunkSize) const
+{
+    // Chunks stop where the complete lines do, like the manifest's ingestedBytes
+    const char *complete = qMax(begin + completeLength(), cursor);
+    QVector<qint64> offsets = { cursor - begin };
+    const char *position = cursor;
+    while (complete - position > chunkSize) {
+        const void *newline = std::memchr(position + chunkSize, '\n', complete - position - chunkSize);
+        if (!newline || static_cast<const char *>(newline) + 1 == complete)
+            break;
+        position = static_cast<const char *>(newline) + 1;
+        offsets.append(position - begin);
+    }
+    offsets.append(complete - begin);
+    return offsets;
+}
@@ -0,0 +1,45 @@
+#ifndef WEATHERCSVPARSER_H
+#define WEATHERCSVPARSER_H
+
+#include "weatherrecord.h"
+#include <QByteArray>
+#include <QFile>
+#include <QVector>
+
+// Reads a Meteostat CSV straight out of a memory-mapped file.
+class WeatherCsvParser
+{
+public:
+    explicit WeatherCsvParser(const QString &filePath);
+    // Reads the line-aligned byte range [from, to) of an opened parser, which must outlive this one
+    WeatherCsvParser(const WeatherCsvParser &source, qint64 from, qint64 to);
+    bool open();
+    // For files still being appended to: a last line without its newline is left for a later read.
+    // Otherwise the end of the file ends the line, like QTextStream::readLine().
+    void setHoldPartialLine(bool hold);
+    // Continues at a line start from an earlier read of the same file
+    bool seek(qint64 offset);
+    bool atEnd() const;
+    // Throws std::runtime_error naming the line number for a malformed line, the cursor is already past it
+    bool readNext(WeatherRecord &record);
+    // Line of the last record read, counted on demand since ranges do not know their first line
+    int lineNumber() const;
+
+    qint64 size() const;
+    // The first length bytes of the mapped file, shared rather than copied, valid while the parser lives
+    QByteArray content(qint64 length) const;
+    // Bytes of whole lines, up to and including the last newline when partial lines are held back
+    qint64 completeLength() const;
+    // Line starts from the cursor on, about chunkSize bytes apart, followed by the end offset
+    QVector<qint64> chunkOffsets(qint64 chunkSize) const;
+
+private:
+    QFile file;
+    const char *begin;
+    const char *cursor;
+    const char *end;
+    const char *lineBegin;
+    bool holdPartialLine;
+};
+
+#endif // WEATHERCSVPARSER_H
@@ -0,0 +1,340 @@
+#include "weatherdatabase.h"
+#include "weathermodel.h"
+#include "weatherrollups.h"
+#include "weathersketches.h"
+#include "weatherstatistics.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QStringList>
+#include <QThread>
+#include <QUuid>
+#include <QVector>
+
+namespace {
+bool execAll(QSqlDatabase &db, const QStringList &statements)
+{
+    QSqlQuery query(db);
+    for (const QString &statement : statements) {
+        if (!query.exec(statement)) {
+            qDebug() << "Statement failed:" << query.lastError().text() << statement;
+            return false;
+        }
+    }
+    return true;
+}
+
+// The layout every database had before schema versions existed
+bool createBaseline(QSqlDatabase &db)
+{
+    QSqlQuery query(db);
+    const bool indexed = query.exec("SELECT 1 FROM sqlite_master WHERE type = 'index' AND name = 'weather_date'") && query.next();
+    query.finish();
+
+    QStringList statements = {
+        R"(
+        CREATE TABLE IF NOT EXISTS weather (
+            id INTEGER PRIMARY KEY AUTOINCREMENT,
+            date TEXT NOT NULL,
+            averageTemperature REAL,
+            minimumTemperature REAL,
+            maximunTemperature REAL,
+            precipitation REAL,
+            snow INTEGER,
+            windDirection INTEGER,
+            windSpeed REAL,
+            windPeakGust REAL,
+            airPressure REAL,
+            sunshineDuration INTEGER
+        )
+        )",
+        R"(
+        CREATE TABLE IF NOT EXISTS weather_statistics (
+            name TEXT PRIMARY KEY,
+            count INTEGER,
+            sum REAL,
+            minimum REAL,
+            maximum REAL
+        )
+        )",
+        R"(
+        CREATE TABLE IF NOT EXISTS weather_files (
+            path TEXT PRIMARY KEY,
+            size INTEGER,
+            modified INTEGER,
+            ingestedBytes INTEGER,
+            hash BLOB
+        )
+        )",
+        "CREATE TABLE IF NOT EXISTS weather_meta (name TEXT PRIMARY KEY, value INTEGER)",
+        // The generation starts at the creation time so a recreated database never matches an old snapshot
+        QString("INSERT OR IGNORE INTO weather_meta (name, value) VALUES ('generation', %1)").arg(QDateTime::currentMSecsSinceEpoch())
+    };
+
+    // Ingest relies on a unique date key for INSERT OR IGNORE deduplication
+    if (!indexed) {
+        statements << "DELETE FROM weather WHERE id NOT IN (SELECT MIN(id) FROM weather GROUP BY date)"
+                   << "CREATE UNIQUE INDEX weather_date ON weather (date)";
+    }
+
+    return execAll(db, statements);
+}
+
+// Rows are keyed and clustered by wall-clock seconds, date stays readable as a generated column
+bool useIntegerTimeKey(QSqlDatabase &db)
+{
+    return execAll(db, {
+        R"(
+        CREATE TABLE weather_keyed (
+            time INTEGER PRIMARY KEY,
+            date TEXT GENERATED ALWAYS AS (strftime('%Y-%m-%dT%H:%M:%S', time, 'unixepoch')) VIRTUAL,
+            averageTemperature REAL,
+            minimumTemperature REAL,
+            maximunTemperature REAL,
+            precipitation REAL,
+            snow INTEGER,
+            windDirection INTEGER,
+            windSpeed REAL,
+            windPeakGust REAL,
+            airPressure REAL,
+            sunshineDuration INTEGER
+        )
+        )",
+        R"(
+        INSERT OR IGNORE INTO weather_keyed (
+            time, averageTemperature, minimumTemperature, maximunTemperature, precipitation, snow,
+            windDirection, windSpeed, windPeakGust, airPressure, sunshineDuration
+        )
+        SELECT CAST(strftime('%s', substr(date, 1, 19)) AS INTEGER), averageTemperature, minimumTemperature,
+               maximunTemperature, precipitation, snow, windDirection, windSpeed, windPeakGust,
+               airPressure, sunshineDuration
+        FROM weather
+        WHERE strftime('%s', substr(date, 1, 19)) IS NOT NULL
+        ORDER BY id
+        )",
+        // Also drops weather_date and any per-column sort indexes of the old table
+        "DROP TABLE weather",
+        "ALTER TABLE weather_keyed RENAME TO weather",
+        // Keeps ad-hoc date filters and ORDER BY date in the Query tab index-driven
+        "CREATE UNIQUE INDEX weather_date ON weather (date)"
+    });
+}
+
+bool createRollups(QSqlDatabase &db)
+{
+    return execAll(db, WeatherRollups::createStatements());
+}
+
+bool createSketches(QSqlDatabase &db)
+{
+    return execAll(db, WeatherSketches::createStatements()) && WeatherSketches::backfill(db);
+}
+
+// Databases from before the statistics table have no row count yet
+bool completeStatistics(QSqlDatabase &db)
+{
+    WeatherStatistics statistics;
+    return statistics.load(db) || statistics.rebuild(db);
+}
+
+// Sorting the table view by a column never has to build an index on the GUI connection
+bool createSortIndexes(QSqlDatabase &db)
+{
+    return execAll(db, WeatherModel::createIndexStatements());
+}
+
+struct Migration
+{
+    int version;
+    const char *description;
+    bool (*apply)(QSqlDatabase &db);
+};
+
+const Migration migrations[] = {
+    { 1, "baseline schema", createBaseline },
+    { 2, "integer time key", useIntegerTimeKey },
+    { 3, "day, month and year rollups", createRollups },
+    { 4, "quantile and histogram sketches", createSketches },
+    { 5, "complete statistics", completeStatistics },
+    { 6, "column sort indexes", createSortIndexes },
+};
+}
+
+const int WeatherDatabase::currentVersion = 6;
+const int WeatherDatabase::busyTimeout = 5000;
+
+int WeatherDatabase::schemaVersion(const QSqlDatabase &db)
+{
+    QSqlQuery query(db);
+    if (!query.exec("SELECT MAX(version) FROM schema_version") || !query.next())
+        return 0;
+    return query.value(0).toInt();
+}
+
+bool WeatherDatabase::migrate(QSqlDatabase &db)
+{
+    QSqlQuery query(db);
+    if (!query.exec("CREATE TABLE IF NOT EXISTS schema_version (version INTEGER PRIMARY KEY, description TEXT, appliedAt TEXT)")) {
+        qDebug() << "Error creating schema version table:" << query.lastError().text();
+        return false;
+    }
+
+    const int version = schemaVersion(db);
+    for (const Migration &migration : migrations) {
+        if (migration.version <= version)
+            continue;
+
+        db.transaction();
+        query.prepare("INSERT INTO schema_version (version, description, appliedAt) VALUES (?, ?, ?)");
+        query.addBindValue(migration.version);
+        query.addBindValue(QString(migration.description));
+        query.addBindValue(QDateTime::currentDateTimeUtc().toString(Qt::ISODate));
+
+        if (!migration.apply(db) || !query.exec() || !db.commit()) {
+            qDebug() << "Migration to schema version" << migration.version << "failed:" << db.lastError().text();
+            db.rollback();
+            return false;
+        }
+        qDebug() << "Migrated database to schema version" << migration.version << "(" << migration.description << ")";
+    }
+
+    return true;
+}
+
+bool WeatherDatabase::initialize(const QString &path)
+{
+    // Migrations are writes like any other
+    QMutexLocker writer(&writeLock(path));
+
+    bool migrated = false;
+    const QString connectionName = QUuid::createUuid().toString();
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+        db.setDatabaseName(path);
+
+        if (!db.open()) {
+            qDebug() << "Error: Unable to open database!" << db.lastError().text();
+        } else {
+            // Upgrades databases from earlier builds in place, no CSV needs to be re-read
+            migrated = migrate(db);
+
+            // Persistent in the file: readers keep their snapshot while an ingest commits
+            QSqlQuery query(db);
+            if (migrated && (!query.exec("PRAGMA journal_mode = WAL") || !query.next() || query.value(0).toString() != "wal"))
+                qWarning() << "Could not switch to WAL journal mode:" << query.lastError().text();
+            query.finish();
+            db.close();
+        }
+    }
+    QSqlDatabase::removeDatabase(connectionName);
+
+    return migrated;
+}
+
+QString WeatherDatabase::connectionName(const QString &path)
+{
+    // Qt connections belong to the thread that opened them, so the pool is keyed by thread
+    return QString("weather-%1-%2").arg(quintptr(QThread::currentThread()), 0, 16).arg(QFileInfo(path).absoluteFilePath());
+}
+
+QSqlDatabase WeatherDatabase::connection(const QString &path)
+{
+    const QString name = connectionName(path);
+    if (QSqlDatabase::contains(name))
+        return QSqlDatabase::database(name);
+
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", name);
+    db.setDatabaseName(path);
+    db.setConnectOptions(QString("QSQLITE_BUSY_TIMEOUT=%1").arg(busyTimeout));
+
+    // Pool threads are retired after a while, their connections go with them
+    QThread *thread = QThread::currentThread();
+    QObject::connect(thread, &QThread::finished, thread, [name]() {
+        QSqlDatabase::removeDatabase(name);
+    }, Qt::DirectConnection);
+
+    if (!db.open()) {
+        qWarning() << "Unable to open" << path << db.lastError().text();
+        return db;
+    }
+
+    // WAL keeps committed pages safe without a sync per transaction
+    QSqlQuery query(db);
+    if (!query.exec("PRAGMA synchronous = NORMAL"))
+        qWarning() << "Could not set synchronous mode:" << query.lastError().text();
+    return db;
+}
+
+void WeatherDatabase::release(const QString &path)
+{
+    const QString name = connectionName(path);
+    if (QSqlDatabase::contains(name))
+        QSqlDatabase::removeDatabase(name);
+}
+
+QRecursiveMutex &WeatherDatabase::writeLock(const QString &path)
+{
+    // One per file for the life of the process, so a rebuild fills its shadow while the live file takes ingests
+    static QMutex mutex;
+    static QHash<QString, QRecursiveMutex *> locks;
+    QMutexLocker locker(&mutex);
+    QRecursiveMutex *&lock = locks[QFileInfo(path).absoluteFilePath()];
+    if (!lock)
+        lock = new QRecursiveMutex;
+    return *lock;
+}
+
+bool WeatherDatabase::copyContents(QSqlDatabase &db, const QString &sourcePath)
+{
+    QSqlQuery query(db);
+    query.prepare("ATTACH DATABASE ? AS source");
+    query.addBindValue(sourcePath);
+    if (!query.exec()) {
+        qWarning() << "Could not attach" << sourcePath << query.lastError().text();
+        return false;
+    }
+
+    // Each table with its primary key; rows whose key is gone are deleted, new and changed rows replaced.
+    // The date column is generated, so weather is compared and copied by its stored columns.
+    QVector<QPair<QString, QString>> tables = { { "weather", "time" }, { "weather_statistics", "name" }, { "weather_files", "path" } };
+    for (int level = 0; level < WeatherRollups::LevelCount; ++level) {
+        tables << qMakePair(WeatherRollups::tableName(static_cast<WeatherRollups::Level>(level)), QString("start"))
+               << qMakePair(WeatherSketches::tableName(static_cast<WeatherRollups::Level>(level)), QString("start, name"));
+    }
+    QStringList statements;
+    for (const auto &table : std::as_const(tables)) {
+        const QString columns = table.first == "weather" ? WeatherRecord::columnList() : QString("*");
+        const QString insertColumns = table.first == "weather" ? QString(" (%1)").arg(columns) : QString();
+        statements << QString("DELETE FROM main.%1 WHERE (%2) NOT IN (SELECT %2 FROM source.%1)").arg(table.first, table.second)
+                   << QString("INSERT OR REPLACE INTO main.%1%2 SELECT %3 FROM source.%1 EXCEPT SELECT %3 FROM main.%1")
+                          .arg(table.first, insertColumns, columns);
+    }
+
+    // Never back to an earlier value, and normally the source's own generation so a snapshot taken there still fits
+    statements << "UPDATE weather_meta SET value = MAX(value + 1, COALESCE((SELECT value FROM source.weather_meta "
+                  "WHERE name = 'generation'), 0)) WHERE name = 'generation'";
+
+    bool replaced = db.transaction() && execAll(db, statements);
+    if (replaced && !db.commit()) {
+        qWarning() << "Commit failed:" << db.lastError().text();
+        replaced = false;
+    }
+    if (!replaced)
+        db.rollback();
+
+    if (!query.exec("DETACH DATABASE source"))
+        qWarning() << "Could not detach" << sourcePath << query.lastError().text();
+    return replaced;
+}
+
+void WeatherDatabase::removeFiles(const QString &path)
+{
+    for (const QString &suffix : { QString(), QString("-wal"), QString("-shm") })
+        QFile::remove(path + suffix);
+}
@@ -0,0 +1,39 @@
+#ifndef WEATHERDATABASE_H
+#define WEATHERDATABASE_H
+
+#include <QRecursiveMutex>
+#include <QSqlDatabase>
+
+// Versioned schema for weather.db, applied in order and recorded in the schema_version table.
+class WeatherDatabase
+{
+public:
+    static const int currentVersion;
+    // Milliseconds a connection waits for a lock before reporting SQLITE_BUSY
+    static const int busyTimeout;
+
+    static int schemaVersion(const QSqlDatabase &db);
+    // Brings an existing database up to currentVersion in place, each step in its own transaction
+    static bool migrate(QSqlDatabase &db);
+    // Opens the file on a private connection, creating it if needed, and migrates it
+    static bool initialize(const QString &path);
+
+    // The calling thread's connection to path, opened on first use and removed when the thread finishes
+    static QSqlDatabase connection(const QString &path);
+    // Closes the calling thread's connection, no QSqlDatabase copy of it may still be alive
+    static void release(const QString &path);
+    // Held for the whole of a write to the file at path; WAL readers never wait, but SQLite admits one writer per file
+    static QRecursiveMutex &writeLock(const QString &path);
+
+    // Makes every row and derived table of db match the database at sourcePath, in one transaction, so readers
+    // see either the old or the new data. This is a copy, not a file swap: only rows that differ are deleted or
+    // written, so the transaction and the WAL grow with the size of the change rather than of the database.
+    static bool copyContents(QSqlDatabase &db, const QString &sourcePath);
+    // The database file and its WAL and shared-memory companions
+    static void removeFiles(const QString &path);
+
+private:
+    static QString connectionName(const QString &path);
+};
+
+#endif // WEATHERDATABASE_H
@@ -0,0 +1,445 @@
+#include "weatheringestor.h"
+#include "weathercsvparser.h"
+#include "weatherdatabase.h"
+#include "weatherpresence.h"
+#include "weatherrollups.h"
+#include "weathersketches.h"
+#include "weathersnapshot.h"
+#include "weatherstore.h"
+#include "weatherstatistics.h"
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QMutex>
+#include <QSet>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QThread>
+#include <utility>
+
+namespace {
+const int batchSize = 4096;
+const int transactionSize = 65536;
+const qint64 chunkBytes = 8 << 20;
+
+// Outlives single ingests so only the first one per database scans the table. The hash is shared by
+// all databases and has its own lock, each index is guarded by the write lock of its database.
+QHash<QString, std::shared_ptr<WeatherPresence>> &presenceIndexes()
+{
+    static QHash<QString, std::shared_ptr<WeatherPresence>> indexes;
+    return indexes;
+}
+
+QMutex &presenceLock()
+{
+    static QMutex mutex;
+    return mutex;
+}
+
+WeatherPresence &presenceIndex(const QString &databasePath)
+{
+    QMutexLocker locker(&presenceLock());
+    std::shared_ptr<WeatherPresence> &index = presenceIndexes()[QFileInfo(databasePath).absoluteFilePath()];
+    if (!index)
+        index = std::make_shared<WeatherPresence>();
+    return *index;
+}
+
+WeatherPresence takePresenceIndex(const QString &databasePath)
+{
+    QMutexLocker locker(&presenceLock());
+    const std::shared_ptr<WeatherPresence> index = presenceIndexes().take(QFileInfo(databasePath).absoluteFilePath());
+    return index ? std::move(*index) : WeatherPresence();
+}
+
+// Files the manifest gained or changed between two loads of it
+QStringList changedFiles(const WeatherManifest &before, const WeatherManifest &after)
+{
+    QStringList paths;
+    for (const QString &path : after.paths()) {
+        const WeatherManifest::Entry previous = before.entry(path);
+        const WeatherManifest::Entry current = after.entry(path);
+        if (previous.path.isEmpty() || previous.size != current.size || previous.modified != current.modified
+            || previous.ingestedBytes != current.ingestedBytes)
+            paths << path;
+    }
+    return paths;
+}
+}
+
+WeatherIngestor::WeatherIngestor(const QString &databasePath)
+    : databasePath(databasePath)
+    , queue(QThread::idealThreadCount() * 4)
+    , collectInserted(false)
+    , tailing(false)
+{
+    pool.setMaxThreadCount(QThread::idealThreadCount());
+}
+
+void WeatherIngestor::setCollectInserted(bool collect)
+{
+    collectInserted = collect;
+}
+
+void WeatherIngestor::setTailing(bool tailing)
+{
+    this->tailing = tailing;
+}
+
+QVector<WeatherRecord> WeatherIngestor::takeInserted()
+{
+    return std::exchange(insertedRecords, QVector<WeatherRecord>());
+}
+
+QStringList WeatherIngestor::csvFiles(const QString &directoryPath)
+{
+    QDir dir(directoryPath);
+    if (!dir.exists()) {
+        qWarning() << "Directory does not exist:" << directoryPath;
+        return QStringList();
+    }
+
+    QStringList files;
+    for (const QString &fileName : dir.entryList(QStringList() << "*.csv", QDir::Files))
+        files << dir.filePath(fileName);
+
+    if (files.isEmpty())
+        qWarning() << "No CSV files found in:" << directoryPath;
+
+    return files;
+}
+
+qint64 WeatherIngestor::ingest(const QStringList &filePaths)
+{
+    if (filePaths.isEmpty())
+        return 0;
+
+    // One ingest writes at a time, a second one waits here instead of running into SQLITE_BUSY
+    QMutexLocker writer(&WeatherDatabase::writeLock(databasePath));
+    QSqlDatabase db = WeatherDatabase::connection(databasePath);
+    if (!db.isOpen()) {
+        qWarning() << "Writer DB open failed:" << db.lastError().text();
+        return 0;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // Files whose size and mtime match the manifest are not even opened
+    WeatherManifest manifest;
+    manifest.load(db);
+    QVector<QPair<WeatherManifest::Entry, WeatherManifest::Entry>> changedFiles;
+    for (const QString &filePath : filePaths) {
+        const QFileInfo info(filePath);
+        WeatherManifest::Entry current;
+        current.path = info.absoluteFilePath();
+        current.size = info.size();
+        current.modified = info.lastModified().toMSecsSinceEpoch();
+
+        const WeatherManifest::Entry previous = manifest.entry(current.path);
+        if (previous.path.isEmpty() || previous.size != current.size || previous.modified != current.modified)
+            changedFiles.append(qMakePair(current, previous));
+    }
+
+    qint64 inserted = 0;
+    if (!changedFiles.isEmpty()) {
+        // Parsing fans out over the pool, the calling thread is the only writer
+        pendingFiles.storeRelaxed(changedFiles.size());
+        for (const auto &file : std::as_const(changedFiles))
+            pool.start([this, file]() { parseFile(file.first, file.second); });
+
+        inserted = writeBatches(db);
+        pool.waitForDone();
+    }
+
+    const qint64 elapsed = qMax<qint64>(timer.elapsed(), 1);
+    qDebug() << "Ingested" << inserted << "rows from" << changedFiles.size() << "changed files in"
+             << elapsed << "ms (" << inserted * 1000 / elapsed << "rows/s )," << filePaths.size() - changedFiles.size()
+             << "files unchanged";
+
+    return inserted;
+}
+
+bool WeatherIngestor::rebuild(const QStringList &filePaths)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    // Only the shadow is locked while it fills, ingests into the live database go on meanwhile
+    const QString shadowPath = databasePath + ".rebuild";
+    QMutexLocker shadowWriter(&WeatherDatabase::writeLock(shadowPath));
+    WeatherDatabase::removeFiles(shadowPath);
+    if (!WeatherDatabase::initialize(shadowPath))
+        return false;
+
+    WeatherManifest before;
+    {
+        QSqlDatabase db = WeatherDatabase::connection(databasePath);
+        if (db.isOpen())
+            before.load(db);
+    }
+    qint64 rows = WeatherIngestor(shadowPath).ingest(filePaths);
+    const qint64 ingestTime = timer.restart();
+
+    // From here on other ingests wait; the files they wrote while the shadow filled go into it too, so the copy keeps their rows
+    QMutexLocker writer(&WeatherDatabase::writeLock(databasePath));
+    WeatherManifest after;
+    {
+        QSqlDatabase db = WeatherDatabase::connection(databasePath);
+        if (db.isOpen())
+            after.load(db);
+    }
+    const QStringList caughtUp = changedFiles(before, after);
+    rows += WeatherIngestor(shadowPath).ingest(caughtUp);
+
+    bool copied = false;
+    if (!filePaths.isEmpty() && rows == 0) {
+        qWarning() << "Rebuild read no rows, keeping" << databasePath;
+    } else {
+        // Store, statistics and presence index come from the shadow, so the copied data starts warm
+        WeatherStore store;
+        WeatherStatistics statistics;
+        bool loaded = false;
+        bool indexed = false;
+        {
+            QSqlDatabase shadow = WeatherDatabase::connection(shadowPath);
+            loaded = shadow.isOpen() && store.load(shadow) && statistics.load(shadow);
+            indexed = loaded && presenceIndex(shadowPath).generation() == WeatherSnapshot::generation(shadow);
+        }
+        WeatherPresence presence = takePresenceIndex(shadowPath);
+
+        QSqlDatabase db = WeatherDatabase::connection(databasePath);
+        copied = db.isOpen() && WeatherDatabase::copyContents(db, shadowPath);
+        if (copied) {
+            const qint64 generation = WeatherSnapshot::generation(db);
+            if (loaded)
+                WeatherSnapshot::save(WeatherSnapshot::pathFor(databasePath), generation, store, statistics);
+            if (indexed) {
+                presence.setGeneration(generation);
+                presenceIndex(databasePath) = std::move(presence);
+            }
+            qDebug() << "Rebuilt" << databasePath << "with" << store.size() << "rows, ingest" << ingestTime
+                     << "ms, catch-up of" << caughtUp.size() << "files and copy" << timer.elapsed() << "ms";
+        }
+    }
+
+    takePresenceIndex(shadowPath);
+    WeatherDatabase::release(shadowPath);
+    WeatherDatabase::removeFiles(shadowPath);
+    return copied;
+}
+
+void WeatherIngestor::parseFile(const WeatherManifest::Entry &current, const WeatherManifest::Entry &previous)
+{
+    auto parser = std::make_shared<WeatherCsvParser>(current.path);
+    parser->setHoldPartialLine(tailing);
+    if (!parser->open()) {
+        qWarning() << "Cannot open file:" << current.path;
+        if (!pendingFiles.deref())
+            queue.close();
+        return;
+    }
+
+    // A file that only grew is read from where the last ingest stopped, if that was the end of a line
+    const QByteArray prefix = parser->content(previous.ingestedBytes);
+    if (previous.ingestedBytes > 0 && previous.ingestedBytes <= parser->size() && prefix.endsWith('\n')
+        && WeatherManifest::hash(prefix) == previous.hash)
+        parser->seek(previous.ingestedBytes);
+
+    // Chunks queue up behind the other files on the same pool, so one large file keeps every core busy
+    const QVector<qint64> offsets = parser->chunkOffsets(chunkBytes);
+    auto file = std::make_shared<FileProgress>();
+    file->parser = parser;
+    file->entry = current;
+    file->remaining.storeRelaxed(offsets.size());
+    for (int chunk = 0; chunk + 1 < offsets.size(); ++chunk) {
+        const qint64 from = offsets.at(chunk);
+        const qint64 to = offsets.at(chunk + 1);
+        pool.start([this, file, from, to]() { parseChunk(file, from, to); });
+    }
+
+    // Hashing the new prefix overlaps with the chunks, it is the last part of the file's work
+    file->entry.ingestedBytes = parser->completeLength();
+    file->entry.hash = WeatherManifest::hash(parser->content(file->entry.ingestedBytes));
+    finishPart(file);
+}
+
+void WeatherIngestor::parseChunk(const std::shared_ptr<FileProgress> &file, qint64 from, qint64 to)
+{
+    WeatherCsvParser parser(*file->parser, from, to);
+    Batch batch;
+    batch.path = file->entry.path;
+    batch.records.reserve(batchSize);
+
+    while (!parser.atEnd()) {
+        try {
+            WeatherRecord record;
+            if (parser.readNext(record))
+                batch.records.append(record);
+        } catch (const std::exception &e) {
+            qWarning() << "Error parsing file:" << file->entry.path << e.what();
+        }
+
+        if (batch.records.size() >= batchSize) {
+            queue.push(std::move(batch));
+            batch = Batch();
+            batch.path = file->entry.path;
+            batch.records.reserve(batchSize);
+        }
+    }
+
+    if (!batch.records.isEmpty())
+        queue.push(std::move(batch));
+    finishPart(file);
+}
+
+void WeatherIngestor::finishPart(const std::shared_ptr<FileProgress> &file)
+{
+    if (file->remaining.deref())
+        return;
+
+    // The manifest entry travels behind the file's last rows so both commit together
+    Batch batch;
+    batch.file = file->entry;
+    queue.push(std::move(batch));
+
+    // The last parser to finish lets the writer drain and stop
+    if (!pendingFiles.deref())
+        queue.close();
+}
+
+qint64 WeatherIngestor::writeBatches(QSqlDatabase &db)
+{
+    QSqlQuery query(db);
+    if (!query.prepare("INSERT OR IGNORE INTO weather (" + WeatherRecord::columnList() + ") VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)")) {
+        qWarning() << "Prepare insert failed:" << query.lastError().text();
+        queue.close();
+        return 0;
+    }
+
+    // Every transaction that adds rows invalidates snapshots taken before it
+    QSqlQuery bumpGeneration(db);
+    bumpGeneration.prepare("UPDATE weather_meta SET value = value + 1 WHERE name = 'generation'");
+
+    // Statistics, rollups and sketches are written in the same transactions as the rows they describe
+    WeatherStatistics statistics;
+    if (!statistics.load(db))
+        statistics.rebuild(db);
+    WeatherRollups rollups;
+    WeatherSketches sketches;
+
+    // Another writer since the last ingest means the bits may be missing rows, so rebuild
+    WeatherPresence &presence = presenceIndex(databasePath);
+    qint64 generation = WeatherSnapshot::generation(db);
+    if (presence.generation() != generation)
+        presence.load(db);
+    bool presenceValid = presence.generation() == generation;
+
+    qint64 inserted = 0;
+    qint64 skipped = 0;
+    qint64 committed = 0;
+    qsizetype committedRecords = 0;
+    int pendingRows = 0;
+    bool inTransaction = false;
+    Batch batch;
+
+    // A file with rows that never made it into the database keeps its old manifest entry and is read again
+    QSet<QString> transactionFiles;
+    QSet<QString> failedFiles;
+
+    auto commit = [&]() {
+        // The aggregates go in with the rows they describe, a failure anywhere drops the whole transaction
+        bool written = statistics.save(db) && rollups.save(db) && sketches.save(db);
+        if (written && inserted > committed && !bumpGeneration.exec()) {
+            qWarning() << "Generation update failed:" << bumpGeneration.lastError().text();
+            written = false;
+        }
+        if (written && !db.commit()) {
+            qWarning() << "Commit failed:" << db.lastError().text();
+            written = false;
+        }
+
+        if (written) {
+            if (inserted > committed)
+                ++generation;
+            committed = inserted;
+            committedRecords = insertedRecords.size();
+        } else {
+            // Counts go back to what the database holds, bits set for the lost rows are no longer trusted
+            db.rollback();
+            inserted = committed;
+            insertedRecords.resize(committedRecords);
+            if (!statistics.load(db))
+                statistics.rebuild(db);
+            rollups = WeatherRollups();
+            sketches = WeatherSketches();
+            presenceValid = false;
+            failedFiles.unite(transactionFiles);
+        }
+        transactionFiles.clear();
+        inTransaction = false;
+        pendingRows = 0;
+    };
+
+    while (queue.pop(batch)) {
+        if (!inTransaction) {
+            db.transaction();
+            inTransaction = true;
+        }
+
+        if (!batch.records.isEmpty())
+            transactionFiles.insert(batch.path);
+
+        for (const WeatherRecord &record : std::as_const(batch.records)) {
+            // Overlapping archives are mostly known rows, those never reach SQLite
+            if (presenceValid && presence.contains(record.timestamp)) {
+                ++skipped;
+                continue;
+            }
+
+            // Missing measurements are stored as NULL rather than 0
+            query.bindValue(0, record.timestamp);
+            for (int field = 0; field < WeatherRecord::FieldCount; ++field)
+                query.bindValue(1 + field, record.variant(static_cast<WeatherRecord::Field>(field)));
+
+            if (!query.exec()) {
+                qWarning() << "Insert failed:" << query.lastError().text();
+                failedFiles.insert(batch.path);
+                continue;
+            }
+            if (query.numRowsAffected() > 0) {
+                statistics.add(record);
+                rollups.add(record);
+                sketches.add(record);
+                if (collectInserted)
+                    insertedRecords.append(record);
+                ++inserted;
+            }
+            presence.insert(record.timestamp);
+            ++pendingRows;
+        }
+
+        if (failedFiles.contains(batch.file.path))
+            qWarning() << "Not all rows of" << batch.file.path << "were stored, it is read again next time";
+        else if (!batch.file.path.isEmpty())
+            WeatherManifest::save(db, batch.file);
+
+        // Commit in large chunks, or whenever the parsers fall behind
+        if (pendingRows >= transactionSize || queue.isEmpty())
+            commit();
+    }
+
+    if (inTransaction)
+        commit();
+
+    // Still current only if nobody else committed in between
+    if (presenceValid && WeatherSnapshot::generation(db) == generation)
+        presence.setGeneration(generation);
+    else
+        presence.clear();
+
+    if (skipped > 0)
+        qDebug() << "Skipped" << skipped << "rows already in the database";
+    return inserted;
+}
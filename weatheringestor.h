@@ -0,0 +1,63 @@
+#ifndef WEATHERINGESTOR_H
+#define WEATHERINGESTOR_H
+
+#include "batchqueue.h"
+#include "weathermanifest.h"
+#include "weatherrecord.h"
+#include <QAtomicInt>
+#include <QSqlDatabase>
+#include <QStringList>
+#include <QThreadPool>
+#include <memory>
+
+class WeatherCsvParser;
+
+class WeatherIngestor
+{
+public:
+    explicit WeatherIngestor(const QString &databasePath);
+    qint64 ingest(const QStringList &filePaths);
+    // Ingests into a shadow file next to the database, then copies the rows that differ over in one transaction;
+    // readers keep the old rows until then. Without files the database is emptied the same way.
+    bool rebuild(const QStringList &filePaths);
+
+    // Keeps the rows that were actually new, for callers that update views in place
+    void setCollectInserted(bool collect);
+    // For files that are still being written: an unterminated last line waits for the next ingest
+    void setTailing(bool tailing);
+    QVector<WeatherRecord> takeInserted();
+
+    static QStringList csvFiles(const QString &directoryPath);
+
+private:
+    // Parsed rows of one file, the last batch of a file carries its new manifest entry instead
+    struct Batch
+    {
+        QVector<WeatherRecord> records;
+        QString path;
+        WeatherManifest::Entry file;
+    };
+
+    // A file being parsed in line-aligned chunks, whichever part finishes last reports the manifest entry
+    struct FileProgress
+    {
+        std::shared_ptr<WeatherCsvParser> parser;
+        WeatherManifest::Entry entry;
+        QAtomicInt remaining;
+    };
+
+    void parseFile(const WeatherManifest::Entry &current, const WeatherManifest::Entry &previous);
+    void parseChunk(const std::shared_ptr<FileProgress> &file, qint64 from, qint64 to);
+    void finishPart(const std::shared_ptr<FileProgress> &file);
+    qint64 writeBatches(QSqlDatabase &db);
+
+    QString databasePath;
+    BatchQueue<Batch> queue;
+    QThreadPool pool;
+    QAtomicInt pendingFiles;
+    bool collectInserted;
+    bool tailing;
+    QVector<WeatherRecord> insertedRecords;
+};
+
+#endif // WEATHERINGESTOR_H
@@ -0,0 +1,61 @@
+#include "weathermanifest.h"
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QSqlError>
+#include <QSqlQuery>
+
+bool WeatherManifest::load(const QSqlDatabase &db)
+{
+    entries.clear();
+
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    if (!query.exec("SELECT path, size, modified, ingestedBytes, hash FROM weather_files")) {
+        qDebug() << "Error loading file manifest:" << query.lastError().text();
+        return false;
+    }
+
+    while (query.next()) {
+        Entry entry;
+        entry.path = query.value(0).toString();
+        entry.size = query.value(1).toLongLong();
+        entry.modified = query.value(2).toLongLong();
+        entry.ingestedBytes = query.value(3).toLongLong();
+        entry.hash = query.value(4).toByteArray();
+        entries.insert(entry.path, entry);
+    }
+
+    return true;
+}
+
+WeatherManifest::Entry WeatherManifest::entry(const QString &path) const
+{
+    return entries.value(path);
+}
+
+QStringList WeatherManifest::paths() const
+{
+    return entries.keys();
+}
+
+bool WeatherManifest::save(const QSqlDatabase &db, const Entry &entry)
+{
+    QSqlQuery query(db);
+    query.prepare("INSERT OR REPLACE INTO weather_files (path, size, modified, ingestedBytes, hash) VALUES (?, ?, ?, ?, ?)");
+    query.addBindValue(entry.path);
+    query.addBindValue(entry.size);
+    query.addBindValue(entry.modified);
+    query.addBindValue(entry.ingestedBytes);
+    query.addBindValue(entry.hash);
+
+    if (!query.exec()) {
+        qDebug() << "Error saving file manifest:" << query.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+QByteArray WeatherManifest::hash(const QByteArray &data)
+{
+    return QCryptographicHash::hash(data, QCryptographicHash::Sha1);
+}
@@ -0,0 +1,35 @@
+#ifndef WEATHERMANIFEST_H
+#define WEATHERMANIFEST_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QSqlDatabase>
+#include <QString>
+#include <QStringList>
+
+// What each CSV file looked like when it was last ingested, stored in the weather_files table.
+class WeatherManifest
+{
+public:
+    struct Entry
+    {
+        QString path;
+        qint64 size = 0;
+        qint64 modified = 0;
+        // Length of the prefix whose lines are all in the database, and its hash
+        qint64 ingestedBytes = 0;
+        QByteArray hash;
+    };
+
+    bool load(const QSqlDatabase &db);
+    Entry entry(const QString &path) const;
+    QStringList paths() const;
+
+    static bool save(const QSqlDatabase &db, const Entry &entry);
+    static QByteArray hash(const QByteArray &data);
+
+private:
+    QHash<QString, Entry> entries;
+};
+
+#endif // WEATHERMANIFEST_H
@@ -1,20 +1,102 @@
 #include "weathermodel.h"
+#include "weatherproxymodel.h"
+#include "weatherstore.h"
+#include <QDebug>
+#include <QSqlError>
+#include <algorithm>
+#include <limits>
+
+namespace {
+const int pageSize = 512;
+const int cachedPages = 64;
+}
 
 WeatherModel::WeatherModel(QObject *parent)
     : QAbstractTableModel(parent)
+    , pages(cachedPages)
+    , fetchedRows(0)
+    , atEnd(true)
+    , sortColumn(0)
+    , sortOrder(Qt::AscendingOrder)
+{
+}
+
+void WeatherModel::setDatabase(const QSqlDatabase &database)
 {
+    db = database;
+    refresh();
 }
 
-void WeatherModel::setWeatherList(const QList<Weather> &list)
+void WeatherModel::refresh()
 {
     beginResetModel();
-    weatherList = list;
+    pages.clear();
+    pageStarts.clear();
+    lastKey = Key();
+    fetchedRows = 0;
+    atEnd = !db.isOpen();
+
+    if (!atEnd) {
+        firstPageQuery = QSqlQuery(db);
+        firstPageQuery.setForwardOnly(true);
+        firstPageQuery.prepare(pageSql(QString()));
+        nextPageQuery = QSqlQuery(db);
+        nextPageQuery.setForwardOnly(true);
+        nextPageQuery.prepare(pageSql(">"));
+        pageQuery = QSqlQuery(db);
+        pageQuery.setForwardOnly(true);
+        pageQuery.prepare(pageSql(">="));
+    }
     endResetModel();
 }
 
-int WeatherModel::rowCount(const QModelIndex & /*parent*/) const
+void WeatherModel::appendRecords(const QVector<WeatherRecord> &records)
 {
-    return weatherList.size();
+    if (records.isEmpty() || !db.isOpen())
+        return;
+
+    QVector<QPair<Key, WeatherRecord>> rows;
+    rows.reserve(records.size());
+    for (const WeatherRecord &record : records)
+        rows.append(qMakePair(keyOf(record), record));
+    std::stable_sort(rows.begin(), rows.end(), [this](const QPair<Key, WeatherRecord> &left, const QPair<Key, WeatherRecord> &right) {
+        return follows(right.first, left.first);
+    });
+
+    // Rows that sort into the fetched range would shift cached pages, re-read instead
+    if (fetchedRows > 0 && !follows(rows.first().first, lastKey)) {
+        refresh();
+        return;
+    }
+
+    // Rows beyond the fetched range arrive through fetchMore
+    if (!atEnd)
+        return;
+
+    beginInsertRows(QModelIndex(), fetchedRows, fetchedRows + rows.size() - 1);
+    for (const QPair<Key, WeatherRecord> &row : std::as_const(rows)) {
+        const int index = fetchedRows / pageSize;
+        if (index == pageStarts.size()) {
+            Page *page = new Page;
+            page->first = row.first;
+            pageStarts.append(row.first);
+            pages.insert(index, page);
+        }
+
+        // An evicted last page picks the rows up from the table when it is read again
+        if (Page *page = pages.object(index)) {
+            page->rows.append(row.second);
+            page->last = row.first;
+        }
+        lastKey = row.first;
+        ++fetchedRows;
+    }
+    endInsertRows();
+}
+
+int WeatherModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : fetchedRows;
 }
 
 int WeatherModel::columnCount(const QModelIndex & /*parent*/) const
@@ -24,25 +106,24 @@ int WeatherModel::columnCount(const QModelIndex & /*parent*/) const
 
 QVariant WeatherModel::data(const QModelIndex &index, int role) const
 {
-    if (!index.isValid() || role != Qt::DisplayRole)
+    if (!index.isValid() || (role != Qt::DisplayRole && role != WeatherProxyModel::SortKeyRole))
+        return QVariant();
+
+    const WeatherRecord *record = recordAt(index.row());
+    if (!record || index.column() < 0 || index.column() > WeatherRecord::FieldCount)
         return QVariant();
 
-    const Weather &weather = weatherList.at(index.row());
-
-    switch (index.column()) {
-    case 0: return weather.getDate().toString("yyyy-MM-dd HH:mm");
-    case 1: return weather.getAverageTemperature();
-    case 2: return weather.getMinimumTemperature();
-    case 3: return weather.getMaximunTemperature();
-    case 4: return weather.getPrecipitation();
-    case 5: return weather.getSnow();
-    case 6: return weather.getWindDirection();
-    case 7: return weather.getWindSpeed();
-    case 8: return weather.getWindPeakGust();
-    case 9: return weather.getAirPressure();
-    case 10: return weather.getSunshineDuration();
-    default: return QVariant();
+    if (index.column() == 0) {
+        if (role == WeatherProxyModel::SortKeyRole)
+            return record->timestamp;
+        return record->isoDate().left(16).replace('T', ' ');
     }
+
+    // Missing measurements show as empty cells and sort first
+    const WeatherRecord::Field field = static_cast<WeatherRecord::Field>(index.column() - 1);
+    if (role == WeatherProxyModel::SortKeyRole)
+        return record->isMissing(field) ? QVariant() : QVariant(record->value(field));
+    return record->variant(field);
 }
 
 QVariant WeatherModel::headerData(int section, Qt::Orientation orientation, int role) const
@@ -69,3 +150,197 @@ QVariant WeatherModel::headerData(int section, Qt::Orientation orientation, int
 
     return QVariant();
 }
+
+bool WeatherModel::canFetchMore(const QModelIndex &parent) const
+{
+    return !parent.isValid() && !atEnd;
+}
+
+void WeatherModel::fetchMore(const QModelIndex &parent)
+{
+    if (parent.isValid() || atEnd)
+        return;
+
+    Page *page = fetchedRows == 0 ? fetchPage(firstPageQuery, nullptr) : fetchPage(nextPageQuery, &lastKey);
+    if (!page || page->rows.isEmpty()) {
+        delete page;
+        atEnd = true;
+        return;
+    }
+
+    const int count = page->rows.size();
+    beginInsertRows(QModelIndex(), fetchedRows, fetchedRows + count - 1);
+    pageStarts.append(page->first);
+    lastKey = page->last;
+    atEnd = count < pageSize;
+    fetchedRows += count;
+    pages.insert(pageStarts.size() - 1, page);
+    endInsertRows();
+}
+
+void WeatherModel::sort(int column, Qt::SortOrder order)
+{
+    column = qBound(0, column, columnCount() - 1);
+    if (column == sortColumn && order == sortOrder)
+        return;
+
+    sortColumn = column;
+    sortOrder = order;
+    refresh();
+}
+
+QVector<double> WeatherModel::columnValues(int column, int first, int last) const
+{
+    first = qMax(first, 0);
+    last = qMin(last, fetchedRows - 1);
+    QVector<double> values;
+    values.reserve(qMax(0, last - first + 1));
+    for (int row = first; row <= last; ++row) {
+        const WeatherRecord *record = recordAt(row);
+        if (!record || column < 0 || column > WeatherRecord::FieldCount)
+            values.append(std::numeric_limits<double>::quiet_NaN());
+        else if (column == 0)
+            values.append(double(record->timestamp));
+        else
+            values.append(record->value(static_cast<WeatherRecord::Field>(column - 1)));
+    }
+    return values;
+}
+
+QString WeatherModel::columnName(int column)
+{
+    if (column == 0)
+        return "time";
+    return WeatherStore::columnName(static_cast<WeatherStore::Column>(column - 1));
+}
+
+// Same values the page query reads back for sortKey and time
+WeatherModel::Key WeatherModel::keyOf(const WeatherRecord &record) const
+{
+    Key key;
+    key.time = record.timestamp;
+    if (sortColumn == 0) {
+        key.value = record.timestamp;
+    } else {
+        const WeatherRecord::Field field = static_cast<WeatherRecord::Field>(sortColumn - 1);
+        key.value = record.isMissing(field) ? -1e308 : record.variant(field).toDouble();
+    }
+    return key;
+}
+
+bool WeatherModel::follows(const Key &key, const Key &previous) const
+{
+    int order = 0;
+    if (sortColumn != 0) {
+        const double value = key.value.toDouble();
+        const double previousValue = previous.value.toDouble();
+        order = value < previousValue ? -1 : (value > previousValue ? 1 : 0);
+    }
+    if (order == 0)
+        order = key.time < previous.time ? -1 : (key.time > previous.time ? 1 : 0);
+    return sortOrder == Qt::DescendingOrder ? order < 0 : order > 0;
+}
+
+QStringList WeatherModel::createIndexStatements()
+{
+    // time itself is the primary key
+    QStringList statements;
+    for (int column = 1; column <= WeatherStore::ColumnCount; ++column)
+        statements << QString("CREATE INDEX IF NOT EXISTS weather_%1_key ON weather (%2, time)").arg(columnName(column), keyExpression(column));
+    return statements;
+}
+
+// NULL never compares in a row value, so missing measurements get a key below every real one
+QString WeatherModel::keyExpression(int column)
+{
+    if (column == 0)
+        return "time";
+    return QString("IFNULL(%1, -1e308)").arg(columnName(column));
+}
+
+QString WeatherModel::sortExpression() const
+{
+    return keyExpression(sortColumn);
+}
+
+QString WeatherModel::pageSql(const QString &comparison) const
+{
+    const bool descending = sortOrder == Qt::DescendingOrder;
+    const QString column = sortExpression();
+
+    QString where;
+    if (!comparison.isEmpty()) {
+        QString op = comparison;
+        if (descending)
+            op.replace('>', '<');
+        // SQLite only seeks an expression index on a plain bound, the row value then trims the ties
+        where = sortColumn == 0 ? QString("WHERE time %1 ?").arg(op)
+                                : QString("WHERE %1 %2= ? AND (%1, time) %3 (?, ?)").arg(column, op.left(1), op);
+    }
+
+    QString orderBy = sortColumn == 0 ? QString("time") : QString("%1, time").arg(column);
+    if (descending)
+        orderBy = sortColumn == 0 ? QString("time DESC") : QString("%1 DESC, time DESC").arg(column);
+
+    return QString("SELECT %1, %2 AS sortKey FROM weather %3 ORDER BY %4 LIMIT %5")
+        .arg(WeatherRecord::columnList(), column, where, orderBy, QString::number(pageSize));
+}
+
+WeatherModel::Page *WeatherModel::fetchPage(QSqlQuery &query, const Key *after) const
+{
+    if (after) {
+        if (sortColumn == 0) {
+            query.bindValue(0, after->time);
+        } else {
+            query.bindValue(0, after->value);
+            query.bindValue(1, after->value);
+            query.bindValue(2, after->time);
+        }
+    }
+
+    if (!query.exec()) {
+        qDebug() << "Error fetching weather page:" << query.lastError().text();
+        return nullptr;
+    }
+
+    Page *page = new Page;
+    page->rows.reserve(pageSize);
+    while (query.next()) {
+        WeatherRecord record;
+        try {
+            record = WeatherRecord::fromQuery(query);
+        } catch (const std::exception &e) {
+            // Keep the row so page offsets stay aligned with the keyset
+            qWarning() << "Error reading weather row:" << e.what();
+            record = WeatherRecord();
+            record.timestamp = query.value(0).toLongLong();
+            record.missing = (1u << WeatherRecord::FieldCount) - 1;
+        }
+        page->rows.append(record);
+        page->last = { query.value(WeatherRecord::FieldCount + 1), record.timestamp };
+        if (page->rows.size() == 1)
+            page->first = page->last;
+    }
+    query.finish();
+
+    return page;
+}
+
+const WeatherRecord *WeatherModel::recordAt(int row) const
+{
+    const int index = row / pageSize;
+    if (index >= pageStarts.size())
+        return nullptr;
+
+    // Evicted pages are re-read from their first key
+    Page *page = pages.object(index);
+    if (!page) {
+        page = fetchPage(pageQuery, &pageStarts.at(index));
+        if (!page)
+            return nullptr;
+        pages.insert(index, page);
+    }
+
+    const int offset = row % pageSize;
+    return offset < page->rows.size() ? &page->rows.at(offset) : nullptr;
+}
@@ -1,7 +1,11 @@
 #ifndef WEATHERMODEL_H
 #define WEATHERMODEL_H
 #include <QAbstractTableModel>
-#include "weather.h"
+#include <QCache>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QStringList>
+#include "weatherrecord.h"
 
 class WeatherModel : public QAbstractTableModel
 {
@@ -9,15 +13,60 @@ class WeatherModel : public QAbstractTableModel
 public:
     explicit WeatherModel(QObject *parent = nullptr);
 
-    void setWeatherList(const QList<Weather> &list);
+    void setDatabase(const QSqlDatabase &database);
+    void refresh();
+    // Rows that were just inserted into the table
+    void appendRecords(const QVector<WeatherRecord> &records);
 
     int rowCount(const QModelIndex &parent = QModelIndex()) const override;
     int columnCount(const QModelIndex &parent = QModelIndex()) const override;
     QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
     QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
+    void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override;
+
+    // Rows [first, last] of a column straight from the records, seconds for the date and NaN where missing
+    QVector<double> columnValues(int column, int first, int last) const;
+
+    static QString columnName(int column);
+    // (key, time) indexes behind keyset pages on every column, created by a schema migration
+    static QStringList createIndexStatements();
 
 private:
-    QList<Weather> weatherList;
+    // Position of a row in the current ORDER BY, time breaks ties
+    struct Key
+    {
+        QVariant value;
+        qint64 time = 0;
+    };
+
+    struct Page
+    {
+        QVector<WeatherRecord> rows;
+        Key first;
+        Key last;
+    };
+
+    Key keyOf(const WeatherRecord &record) const;
+    bool follows(const Key &key, const Key &previous) const;
+    static QString keyExpression(int column);
+    QString sortExpression() const;
+    QString pageSql(const QString &comparison) const;
+    Page *fetchPage(QSqlQuery &query, const Key *after) const;
+    const WeatherRecord *recordAt(int row) const;
+
+    QSqlDatabase db;
+    QSqlQuery firstPageQuery;
+    QSqlQuery nextPageQuery;
+    mutable QSqlQuery pageQuery;
+    mutable QCache<int, Page> pages;
+    QVector<Key> pageStarts;
+    Key lastKey;
+    int fetchedRows;
+    bool atEnd;
+    int sortColumn;
+    Qt::SortOrder sortOrder;
 };
 
 #endif // WEATHERMODEL_H
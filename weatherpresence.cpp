@@ -0,0 +1,85 @@
+#include "weatherpresence.h"
+#include "weathersnapshot.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QSqlError>
+#include <QSqlQuery>
+
+bool WeatherPresence::load(const QSqlDatabase &db)
+{
+    clear();
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // Read the generation first, a commit landing during the scan then only makes the index stale
+    const qint64 generation = WeatherSnapshot::generation(db);
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    if (generation < 0 || !query.exec("SELECT time FROM weather")) {
+        qDebug() << "Error loading presence index:" << query.lastError().text();
+        return false;
+    }
+
+    while (query.next())
+        insert(query.value(0).toLongLong());
+
+    loadedGeneration = generation;
+    qDebug() << "Built presence index of" << count << "rows in" << pages.size() << "pages in" << timer.elapsed() << "ms";
+    return true;
+}
+
+void WeatherPresence::clear()
+{
+    pages.clear();
+    count = 0;
+    loadedGeneration = -1;
+}
+
+bool WeatherPresence::contains(qint64 timestamp) const
+{
+    if (timestamp % slotSeconds != 0)
+        return false;
+
+    const qint64 slot = timestamp / slotSeconds;
+    const auto page = pages.constFind(slot >> pageShift);
+    if (page == pages.cend())
+        return false;
+
+    const qint64 bit = slot & (pageSlots - 1);
+    return page->at(bit / 64) & (quint64(1) << (bit % 64));
+}
+
+void WeatherPresence::insert(qint64 timestamp)
+{
+    if (timestamp % slotSeconds != 0)
+        return;
+
+    const qint64 slot = timestamp / slotSeconds;
+    QVector<quint64> &page = pages[slot >> pageShift];
+    if (page.isEmpty())
+        page.resize(pageSlots / 64);
+
+    const qint64 bit = slot & (pageSlots - 1);
+    quint64 &word = page[bit / 64];
+    const quint64 mask = quint64(1) << (bit % 64);
+    if (!(word & mask)) {
+        word |= mask;
+        ++count;
+    }
+}
+
+qint64 WeatherPresence::size() const
+{
+    return count;
+}
+
+qint64 WeatherPresence::generation() const
+{
+    return loadedGeneration;
+}
+
+void WeatherPresence::setGeneration(qint64 generation)
+{
+    loadedGeneration = generation;
+}
@@ -0,0 +1,37 @@
+#ifndef WEATHERPRESENCE_H
+#define WEATHERPRESENCE_H
+
+#include <QHash>
+#include <QSqlDatabase>
+#include <QVector>
+
+// One bit per minute slot that has a row in the weather table, in pages allocated on first use.
+class WeatherPresence
+{
+public:
+    static const qint64 slotSeconds = 60;
+
+    // Rebuilds from the table and remembers the generation it reflects
+    bool load(const QSqlDatabase &db);
+    void clear();
+
+    // A set bit means the row is stored; timestamps off the minute grid are never set
+    bool contains(qint64 timestamp) const;
+    void insert(qint64 timestamp);
+    qint64 size() const;
+
+    // -1 until loaded, the index is only trusted while this matches the database
+    qint64 generation() const;
+    void setGeneration(qint64 generation);
+
+private:
+    // 65536 slots, about 45 days, in 8 KiB per page
+    static const int pageShift = 16;
+    static const qint64 pageSlots = qint64(1) << pageShift;
+
+    QHash<qint64, QVector<quint64>> pages;
+    qint64 count = 0;
+    qint64 loadedGeneration = -1;
+};
+
+#endif // WEATHERPRESENCE_H
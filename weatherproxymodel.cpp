@@ -1,10 +1,139 @@
 
 #include "weatherproxymodel.h"
 #include "weathermodel.h"
+#include "querymodel.h"
+#include <QCollator>
+#include <QRegularExpression>
+#include <QThread>
+#include <QtConcurrent/QtConcurrent>
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+namespace {
+struct SortRun
+{
+    int first;
+    int middle;
+    int last;
+};
+
+struct WordRange
+{
+    int first;
+    int last;
+};
+
+// Meteostat column codes in WeatherStore::Column order
+const char *const columnCodes[] = { "tavg", "tmin", "tmax", "prcp", "snow", "wdir", "wspd", "wpgt", "pres", "tsun" };
+
+// ANDs one comparison into 64 rows per bitmap word; the branch-free inner loop vectorizes
+template <typename Accept>
+void filterWords(quint64 *words, const double *values, int rows, const WordRange &range, Accept accept)
+{
+    for (int word = range.first; word < range.last; ++word) {
+        const int base = word * 64;
+        const int count = qMin(64, rows - base);
+        quint64 bits = 0;
+        for (int bit = 0; bit < count; ++bit)
+            bits |= quint64(accept(values[base + bit])) << bit;
+        words[word] &= bits;
+    }
+}
+
+// NaN marks a missing value and fails every comparison, as NULL does in SQL
+void applyFilter(quint64 *words, const double *values, int rows, const WordRange &range,
+                 WeatherQuery::Comparison comparison, double operand)
+{
+    switch (comparison) {
+    case WeatherQuery::Less:
+        filterWords(words, values, rows, range, [=](double value) { return value < operand; });
+        break;
+    case WeatherQuery::LessOrEqual:
+        filterWords(words, values, rows, range, [=](double value) { return value <= operand; });
+        break;
+    case WeatherQuery::Equal:
+        filterWords(words, values, rows, range, [=](double value) { return value == operand; });
+        break;
+    case WeatherQuery::NotEqual:
+        filterWords(words, values, rows, range, [=](double value) { return value == value && value != operand; });
+        break;
+    case WeatherQuery::GreaterOrEqual:
+        filterWords(words, values, rows, range, [=](double value) { return value >= operand; });
+        break;
+    case WeatherQuery::Greater:
+        filterWords(words, values, rows, range, [=](double value) { return value > operand; });
+        break;
+    case WeatherQuery::IsMissing:
+        filterWords(words, values, rows, range, [](double value) { return value != value; });
+        break;
+    case WeatherQuery::IsPresent:
+        filterWords(words, values, rows, range, [](double value) { return value == value; });
+        break;
+    }
+}
+
+bool isNumeric(const QVariant &value)
+{
+    switch (value.userType()) {
+    case QMetaType::Int:
+    case QMetaType::UInt:
+    case QMetaType::LongLong:
+    case QMetaType::ULongLong:
+    case QMetaType::Float:
+    case QMetaType::Double:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Sorts row numbers in per-core runs, then merges neighbouring runs in parallel
+template <typename Less>
+QVector<int> sortedPermutation(int count, Less less)
+{
+    QVector<int> permutation(count);
+    std::iota(permutation.begin(), permutation.end(), 0);
+    int *rows = permutation.data();
+
+    const int chunks = qBound(1, count / 8192, QThread::idealThreadCount());
+    QVector<SortRun> runs;
+    for (int chunk = 0; chunk < chunks; ++chunk) {
+        const int first = static_cast<int>(qint64(count) * chunk / chunks);
+        const int last = static_cast<int>(qint64(count) * (chunk + 1) / chunks);
+        runs.append({ first, last, last });
+    }
+
+    QtConcurrent::blockingMap(runs, [=](const SortRun &run) {
+        std::stable_sort(rows + run.first, rows + run.last, less);
+    });
+
+    while (runs.size() > 1) {
+        QVector<SortRun> merges;
+        for (int i = 0; i + 1 < runs.size(); i += 2)
+            merges.append({ runs[i].first, runs[i].last, runs[i + 1].last });
+
+        QtConcurrent::blockingMap(merges, [=](const SortRun &run) {
+            std::inplace_merge(rows + run.first, rows + run.middle, rows + run.last, less);
+        });
+
+        if (runs.size() % 2)
+            merges.append({ runs.last().first, runs.last().last, runs.last().last });
+        for (SortRun &run : merges)
+            run.middle = run.last;
+        runs = merges;
+    }
+
+    return permutation;
+}
+}
 
 WeatherProxyModel::WeatherProxyModel(QObject *parent)
     : QSortFilterProxyModel(parent),
-    filterColumnIndex(-1)
+    filterColumnIndex(-1),
+    sortRankColumn(-1),
+    filterBitmapRows(0),
+    filterBitmapValid(false)
 {
     setSortCaseSensitivity(Qt::CaseInsensitive);
     setFilterCaseSensitivity(Qt::CaseInsensitive);
@@ -22,8 +151,232 @@ void WeatherProxyModel::setFilterColumn(int column)
     invalidateFilter();
 }
 
+void WeatherProxyModel::setColumnFilters(const QVector<ColumnFilter> &filters)
+{
+    columnFilters = filters;
+    clearFilterBitmap();
+    invalidateFilter();
+}
+
+bool WeatherProxyModel::setFilterExpression(const QString &expression)
+{
+    static const QRegularExpression term(R"(^\s*(\w+)\s*(<=|>=|<>|!=|==|=|<|>)\s*([-+]?\d+(?:\.\d+)?)\s*$)");
+    static const QRegularExpression conjunction(R"(\s+and\s+)", QRegularExpression::CaseInsensitiveOption);
+
+    QVector<ColumnFilter> filters;
+    if (!expression.trimmed().isEmpty()) {
+        for (const QString &part : expression.split(conjunction)) {
+            const QRegularExpressionMatch match = term.match(part);
+            const int column = match.hasMatch() ? sourceColumn(match.captured(1)) : -1;
+            if (column < 0)
+                return false;
+
+            const QString op = match.captured(2);
+            WeatherQuery::Comparison comparison = WeatherQuery::Equal;
+            if (op == "<")
+                comparison = WeatherQuery::Less;
+            else if (op == "<=")
+                comparison = WeatherQuery::LessOrEqual;
+            else if (op == ">")
+                comparison = WeatherQuery::Greater;
+            else if (op == ">=")
+                comparison = WeatherQuery::GreaterOrEqual;
+            else if (op == "<>" || op == "!=")
+                comparison = WeatherQuery::NotEqual;
+            filters.append({ column, comparison, match.captured(3).toDouble() });
+        }
+    }
+
+    setColumnFilters(filters);
+    return true;
+}
+
+int WeatherProxyModel::sourceColumn(const QString &name) const
+{
+    if (!sourceModel())
+        return -1;
+
+    QString columnName = name;
+    for (int column = 0; column < WeatherStore::ColumnCount; ++column) {
+        if (name.compare(columnCodes[column], Qt::CaseInsensitive) == 0)
+            columnName = WeatherStore::columnName(static_cast<WeatherStore::Column>(column));
+    }
+
+    // WeatherModel shows readable headers, its columns are matched by their table names
+    const bool weatherModel = qobject_cast<WeatherModel *>(sourceModel());
+    for (int column = 0; column < sourceModel()->columnCount(); ++column) {
+        const QString header = weatherModel ? WeatherModel::columnName(column)
+                                            : sourceModel()->headerData(column, Qt::Horizontal).toString();
+        if (header.compare(columnName, Qt::CaseInsensitive) == 0)
+            return column;
+    }
+    return -1;
+}
+
+void WeatherProxyModel::setSourceModel(QAbstractItemModel *sourceModel)
+{
+    for (const QMetaObject::Connection &connection : std::as_const(sourceConnections))
+        disconnect(connection);
+    sourceConnections.clear();
+
+    // Connected ahead of the base class so stale ranks are dropped before it re-sorts
+    if (sourceModel) {
+        sourceConnections
+            << connect(sourceModel, &QAbstractItemModel::modelAboutToBeReset, this, &WeatherProxyModel::clearSortRanks)
+            << connect(sourceModel, &QAbstractItemModel::layoutAboutToBeChanged, this, &WeatherProxyModel::clearSortRanks)
+            << connect(sourceModel, &QAbstractItemModel::rowsAboutToBeInserted, this, &WeatherProxyModel::clearSortRanks)
+            << connect(sourceModel, &QAbstractItemModel::rowsAboutToBeRemoved, this, &WeatherProxyModel::clearSortRanks)
+            << connect(sourceModel, &QAbstractItemModel::dataChanged, this, &WeatherProxyModel::clearSortRanks)
+            << connect(sourceModel, &QAbstractItemModel::modelAboutToBeReset, this, &WeatherProxyModel::clearFilterBitmap)
+            << connect(sourceModel, &QAbstractItemModel::rowsInserted, this, &WeatherProxyModel::sourceRowsInserted)
+            << connect(sourceModel, &QAbstractItemModel::rowsAboutToBeRemoved, this, &WeatherProxyModel::clearFilterBitmap)
+            << connect(sourceModel, &QAbstractItemModel::dataChanged, this, &WeatherProxyModel::clearFilterBitmap);
+    }
+    clearFilterBitmap();
+
+    QSortFilterProxyModel::setSourceModel(sourceModel);
+}
+
+void WeatherProxyModel::sort(int column, Qt::SortOrder order)
+{
+    // WeatherModel sorts in SQL, the proxy keeps its source order
+    if (qobject_cast<WeatherModel *>(sourceModel())) {
+        sourceModel()->sort(column, order);
+        return;
+    }
+
+    buildSortRanks(column);
+    QSortFilterProxyModel::sort(column, order);
+}
+
+void WeatherProxyModel::buildSortRanks(int column)
+{
+    clearSortRanks();
+    if (!sourceModel() || column < 0)
+        return;
+
+    const int count = sourceModel()->rowCount();
+    QVector<QVariant> keys(count);
+    bool numeric = true;
+    for (int row = 0; row < count; ++row) {
+        keys[row] = sourceModel()->data(sourceModel()->index(row, column), SortKeyRole);
+        if (keys[row].isValid() && !isNumeric(keys[row]))
+            numeric = false;
+    }
+
+    QVector<int> permutation;
+    if (numeric) {
+        QVector<double> values(count);
+        for (int row = 0; row < count; ++row)
+            values[row] = keys[row].isValid() ? keys[row].toDouble() : -std::numeric_limits<double>::infinity();
+        const double *value = values.constData();
+        permutation = sortedPermutation(count, [=](int left, int right) { return value[left] < value[right]; });
+    } else {
+        QCollator collator;
+        collator.setCaseSensitivity(sortCaseSensitivity());
+        QVector<QCollatorSortKey> collationKeys;
+        collationKeys.reserve(count);
+        for (int row = 0; row < count; ++row)
+            collationKeys.append(collator.sortKey(keys[row].toString()));
+        const QCollatorSortKey *key = collationKeys.constData();
+        permutation = sortedPermutation(count, [=](int left, int right) { return key[left].compare(key[right]) < 0; });
+    }
+
+    sortRanks.resize(count);
+    for (int rank = 0; rank < count; ++rank)
+        sortRanks[permutation[rank]] = rank;
+    sortRankColumn = column;
+}
+
+void WeatherProxyModel::clearSortRanks()
+{
+    sortRanks.clear();
+    sortRankColumn = -1;
+}
+
+// Source rows [first, last] of one column as doubles, NaN where missing; the known models hand out raw values
+QVector<double> WeatherProxyModel::columnValues(int column, int first, int last) const
+{
+    if (const QueryModel *queryModel = qobject_cast<QueryModel *>(sourceModel()))
+        return queryModel->result().numericColumn(column, first, last - first + 1);
+    if (const WeatherModel *weatherModel = qobject_cast<WeatherModel *>(sourceModel()))
+        return weatherModel->columnValues(column, first, last);
+
+    QVector<double> values(last - first + 1, std::numeric_limits<double>::quiet_NaN());
+    for (int row = first; row <= last; ++row) {
+        const QVariant key = sourceModel()->data(sourceModel()->index(row, column), SortKeyRole);
+        bool ok = false;
+        const double value = key.toDouble(&ok);
+        if (key.isValid() && ok)
+            values[row - first] = value;
+    }
+    return values;
+}
+
+// Evaluates the rows from the start of firstRow's word on, the words before it are already final
+void WeatherProxyModel::updateFilterBitmap(int firstRow) const
+{
+    const int count = sourceModel() ? sourceModel()->rowCount() : 0;
+    const int firstWord = qBound(0, firstRow, count) / 64;
+    const int first = firstWord * 64;
+    const int rows = count - first;
+    const int wordCount = (rows + 63) / 64;
+    filterBitmap.resize(firstWord + wordCount);
+    std::fill(filterBitmap.begin() + firstWord, filterBitmap.end(), ~quint64(0));
+    filterBitmapRows = count;
+    filterBitmapValid = true;
+    if (rows == 0)
+        return;
+
+    // Model data is read on this thread, only the comparisons fan out
+    QVector<QVector<double>> values;
+    for (const ColumnFilter &filter : std::as_const(columnFilters))
+        values.append(columnValues(filter.column, first, count - 1));
+
+    QVector<WordRange> ranges;
+    const int chunks = qBound(1, wordCount / 1024, QThread::idealThreadCount());
+    for (int chunk = 0; chunk < chunks; ++chunk)
+        ranges.append({ static_cast<int>(qint64(wordCount) * chunk / chunks), static_cast<int>(qint64(wordCount) * (chunk + 1) / chunks) });
+
+    quint64 *words = filterBitmap.data() + firstWord;
+    const ColumnFilter *filters = columnFilters.constData();
+    const QVector<double> *columns = values.constData();
+    const int filterCount = columnFilters.size();
+    QtConcurrent::blockingMap(ranges, [=](const WordRange &range) {
+        for (int filter = 0; filter < filterCount; ++filter)
+            applyFilter(words, columns[filter].constData(), rows, range, filters[filter].comparison, filters[filter].value);
+    });
+}
+
+void WeatherProxyModel::clearFilterBitmap()
+{
+    filterBitmap.clear();
+    filterBitmapRows = 0;
+    filterBitmapValid = false;
+}
+
+// Batches and pages land at the end and only add their own bits, rows inserted anywhere else start over
+void WeatherProxyModel::sourceRowsInserted(const QModelIndex &parent, int first, int /*last*/)
+{
+    if (parent.isValid() || !filterBitmapValid)
+        return;
+    if (first == filterBitmapRows)
+        updateFilterBitmap(first);
+    else
+        clearFilterBitmap();
+}
+
 bool WeatherProxyModel::filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const
 {
+    if (!columnFilters.isEmpty()) {
+        if (!filterBitmapValid)
+            updateFilterBitmap(0);
+        else if (sourceRow >= filterBitmapRows)
+            updateFilterBitmap(filterBitmapRows);
+        if (sourceRow / 64 >= filterBitmap.size() || !((filterBitmap.at(sourceRow / 64) >> (sourceRow % 64)) & 1))
+            return false;
+    }
+
     if (filterText.isEmpty())
         return true;
 
@@ -38,8 +391,18 @@ bool WeatherProxyModel::filterAcceptsRow(int sourceRow, const QModelIndex &sourc
 
 bool WeatherProxyModel::lessThan(const QModelIndex &left, const QModelIndex &right) const
 {
-    QVariant leftData = sourceModel()->data(left);
-    QVariant rightData = sourceModel()->data(right);
+    if (left.column() == sortRankColumn && left.row() < sortRanks.size() && right.row() < sortRanks.size())
+        return sortRanks.at(left.row()) < sortRanks.at(right.row());
+
+    QVariant leftData = sourceModel()->data(left, SortKeyRole);
+    QVariant rightData = sourceModel()->data(right, SortKeyRole);
+    if (!leftData.isValid() || !rightData.isValid()) {
+        leftData = sourceModel()->data(left);
+        rightData = sourceModel()->data(right);
+    }
+
+    if (isNumeric(leftData) && isNumeric(rightData))
+        return leftData.toDouble() < rightData.toDouble();
 
     // Try to compare as numbers first
     bool ok1, ok2;
@@ -1,24 +1,59 @@
 #ifndef WEATHERPROXYMODEL_H
 #define WEATHERPROXYMODEL_H
 
+#include "weatherquery.h"
 #include <QSortFilterProxyModel>
 
 class WeatherProxyModel : public QSortFilterProxyModel
 {
     Q_OBJECT
 public:
+    // Source models return native numbers, integer timestamps or strings for this role
+    enum Roles {
+        SortKeyRole = Qt::UserRole + 1
+    };
+
+    // Typed condition on a source column, rows must satisfy every filter
+    struct ColumnFilter
+    {
+        int column;
+        WeatherQuery::Comparison comparison;
+        double value;
+    };
+
     explicit WeatherProxyModel(QObject *parent = nullptr);
 
     void setFilterString(const QString &text);
     void setFilterColumn(int column);
+    void setColumnFilters(const QVector<ColumnFilter> &filters);
+    // "tmax > 30 and prcp > 10", Meteostat codes or column names; false leaves the filters unchanged
+    bool setFilterExpression(const QString &expression);
+    int sourceColumn(const QString &name) const;
+    void setSourceModel(QAbstractItemModel *sourceModel) override;
+    void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override;
 
 protected:
     bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const override;
     bool lessThan(const QModelIndex &left, const QModelIndex &right) const override;
 
 private:
+    void buildSortRanks(int column);
+    void clearSortRanks();
+    QVector<double> columnValues(int column, int first, int last) const;
+    void updateFilterBitmap(int firstRow) const;
+    void clearFilterBitmap();
+    void sourceRowsInserted(const QModelIndex &parent, int first, int last);
+
     QString filterText;
     int filterColumnIndex;
+    QVector<int> sortRanks;
+    int sortRankColumn;
+    QVector<ColumnFilter> columnFilters;
+    // One bit per source row, built on first use after the filters or the source change, appended rows extend it
+    mutable QVector<quint64> filterBitmap;
+    mutable int filterBitmapRows;
+    mutable bool filterBitmapValid;
+    QList<QMetaObject::Connection> sourceConnections;
 };
 
 #endif // WEATHERPROXYMODEL_H
@@ -0,0 +1,124 @@
+#include "weatherpyramid.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// Own copies, so the store can keep appending to its columns without detaching them
+WeatherPyramid::WeatherPyramid(const QVector<qint32> &days, const QVector<float> &values)
+    : days(days.cbegin(), days.cend())
+    , values(values.cbegin(), values.cend())
+{
+    update(0);
+}
+
+void WeatherPyramid::append(const QVector<qint32> &newDays, const QVector<float> &newValues)
+{
+    const qsizetype first = values.size();
+    days += newDays;
+    values += newValues;
+    update(first);
+}
+
+// Level 1 pairs up raw rows, every further level pairs up the buckets below it; from row first on
+// each level recomputes only the buckets that changed, which halve on the way up
+void WeatherPyramid::update(qsizetype first)
+{
+    qsizetype count = values.size();
+    for (int index = 0; count > 1; ++index) {
+        const qsizetype buckets = (count + 1) / 2;
+        if (index == levels.size())
+            levels.append(Level());
+        Level &level = levels[index];
+        level.minimum.resize(buckets);
+        level.maximum.resize(buckets);
+        level.sum.resize(buckets);
+        level.count.resize(buckets);
+
+        first /= 2;
+        if (index == 0) {
+            for (qsizetype bucket = first; bucket < buckets; ++bucket) {
+                const qsizetype left = bucket * 2;
+                const qsizetype right = qMin(left + 1, count - 1);
+                const float a = values.at(left);
+                const float b = right != left ? values.at(right) : a;
+                // fmin/fmax return the other operand for a NaN, a bucket only stays NaN when fully missing
+                level.minimum[bucket] = std::fmin(a, b);
+                level.maximum[bucket] = std::fmax(a, b);
+                level.sum[bucket] = (std::isnan(a) ? 0.0 : a) + (right != left && !std::isnan(b) ? b : 0.0);
+                level.count[bucket] = !std::isnan(a) + (right != left && !std::isnan(b));
+            }
+        } else {
+            const Level &below = levels.at(index - 1);
+            for (qsizetype bucket = first; bucket < buckets; ++bucket) {
+                const qsizetype left = bucket * 2;
+                const qsizetype right = qMin(left + 1, count - 1);
+                level.minimum[bucket] = std::fmin(below.minimum[left], below.minimum[right]);
+                level.maximum[bucket] = std::fmax(below.maximum[left], below.maximum[right]);
+                level.sum[bucket] = below.sum[left] + (right != left ? below.sum[right] : 0.0);
+                level.count[bucket] = below.count[left] + (right != left ? below.count[right] : 0);
+            }
+        }
+
+        count = buckets;
+    }
+}
+
+qsizetype WeatherPyramid::size() const
+{
+    return values.size();
+}
+
+QPair<double, double> WeatherPyramid::range() const
+{
+    if (!levels.isEmpty())
+        return qMakePair<double, double>(levels.last().minimum.first(), levels.last().maximum.first());
+    const double value = values.isEmpty() ? std::numeric_limits<double>::quiet_NaN() : values.first();
+    return qMakePair(value, value);
+}
+
+QPair<qsizetype, qsizetype> WeatherPyramid::rowRange(qint32 fromDay, qint32 toDay) const
+{
+    const qint32 *begin = days.constData();
+    const qint32 *end = begin + days.size();
+    const qint32 *first = std::lower_bound(begin, end, fromDay);
+    const qint32 *last = std::upper_bound(first, end, toDay);
+    return qMakePair<qsizetype, qsizetype>(first - begin, last - begin);
+}
+
+QVector<QPointF> WeatherPyramid::sample(qsizetype first, qsizetype last, int maxPoints, Reduction reduction) const
+{
+    QVector<QPointF> points;
+    first = qMax<qsizetype>(first, 0);
+    last = qMin(last, values.size());
+    if (first >= last || maxPoints <= 0)
+        return points;
+
+    // Coarsest detail that still gives at most one bucket per requested point
+    int level = 0;
+    while (level < levels.size() && ((last - first) >> level) > maxPoints)
+        ++level;
+
+    const qsizetype firstBucket = first >> level;
+    const qsizetype lastBucket = (last - 1) >> level;
+    points.reserve(lastBucket - firstBucket + 1);
+
+    for (qsizetype bucket = firstBucket; bucket <= lastBucket; ++bucket) {
+        const qsizetype row = bucket << level;
+        double value = 0.0;
+        if (level == 0) {
+            value = values[bucket];
+        } else {
+            const Level &current = levels[level - 1];
+            switch (reduction) {
+            case Minimum: value = current.minimum[bucket]; break;
+            case Maximum: value = current.maximum[bucket]; break;
+            case Mean: value = current.count[bucket] > 0 ? current.sum[bucket] / current.count[bucket] : std::numeric_limits<double>::quiet_NaN(); break;
+            }
+        }
+        if (std::isnan(value))
+            continue;
+        points.append(QPointF(WeatherStore::toMSecsSinceEpoch(days[row]), value));
+    }
+
+    return points;
+}
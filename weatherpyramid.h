@@ -0,0 +1,44 @@
+#ifndef WEATHERPYRAMID_H
+#define WEATHERPYRAMID_H
+
+#include "weatherstore.h"
+#include <QPointF>
+#include <QVector>
+
+// Min/max/sum per power-of-two bucket of rows for one store column, NaN rows are skipped.
+class WeatherPyramid
+{
+public:
+    enum Reduction {
+        Minimum,
+        Maximum,
+        Mean
+    };
+
+    WeatherPyramid(const QVector<qint32> &days, const QVector<float> &values);
+    // Rows after the last one, in date order
+    void append(const QVector<qint32> &newDays, const QVector<float> &newValues);
+
+    qsizetype size() const;
+    // Lowest and highest value, NaN for a column without any
+    QPair<double, double> range() const;
+    QPair<qsizetype, qsizetype> rowRange(qint32 fromDay, qint32 toDay) const;
+    QVector<QPointF> sample(qsizetype first, qsizetype last, int maxPoints, Reduction reduction) const;
+
+private:
+    struct Level
+    {
+        QVector<float> minimum;
+        QVector<float> maximum;
+        QVector<double> sum;
+        QVector<qint32> count;
+    };
+
+    void update(qsizetype first);
+
+    QVector<qint32> days;
+    QVector<float> values;
+    QVector<Level> levels;
+};
+
+#endif // WEATHERPYRAMID_H
@@ -0,0 +1,288 @@
+#include "weatherquery.h"
+#include <QDebug>
+#include <QSqlError>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+const char *const operators[] = { "<", "<=", "=", "<>", ">=", ">" };
+const char *const functions[] = { "COUNT", "SUM", "AVG", "MIN", "MAX" };
+
+// Missing values behave like SQL NULL: every comparison fails, only IsMissing matches
+bool compare(double value, WeatherQuery::Comparison comparison, double operand)
+{
+    const bool missing = std::isnan(value);
+    switch (comparison) {
+    case WeatherQuery::Less: return !missing && value < operand;
+    case WeatherQuery::LessOrEqual: return !missing && value <= operand;
+    case WeatherQuery::Equal: return !missing && value == operand;
+    case WeatherQuery::NotEqual: return !missing && value != operand;
+    case WeatherQuery::GreaterOrEqual: return !missing && value >= operand;
+    case WeatherQuery::Greater: return !missing && value > operand;
+    case WeatherQuery::IsMissing: return missing;
+    case WeatherQuery::IsPresent: return !missing;
+    }
+    return false;
+}
+}
+
+WeatherQuery &WeatherQuery::from(qint64 time)
+{
+    hasFrom = true;
+    fromTime = time;
+    return *this;
+}
+
+WeatherQuery &WeatherQuery::to(qint64 time)
+{
+    hasTo = true;
+    toTime = time;
+    return *this;
+}
+
+WeatherQuery &WeatherQuery::column(int column)
+{
+    columns.append(column);
+    return *this;
+}
+
+WeatherQuery &WeatherQuery::where(int column, Comparison comparison, double value)
+{
+    predicates.append({ column, comparison, value });
+    return *this;
+}
+
+WeatherQuery &WeatherQuery::aggregate(Function function, int column)
+{
+    aggregates.append({ function, column });
+    return *this;
+}
+
+WeatherQuery &WeatherQuery::orderBy(int column, Qt::SortOrder order)
+{
+    ordered = true;
+    orderColumn = column;
+    sortOrder = order;
+    return *this;
+}
+
+WeatherQuery &WeatherQuery::limit(int rows)
+{
+    rowLimit = rows;
+    return *this;
+}
+
+QString WeatherQuery::sql() const
+{
+    QString sql = "SELECT ";
+    if (!aggregates.isEmpty() || !columns.isEmpty())
+        sql += columnNames().join(", ");
+    else
+        sql += WeatherRecord::columnList();
+    sql += " FROM weather";
+
+    // time bounds come first so SQLite walks the primary key range
+    QStringList conditions;
+    if (hasFrom)
+        conditions << "time >= ?";
+    if (hasTo)
+        conditions << "time < ?";
+    for (const Predicate &predicate : predicates) {
+        if (predicate.comparison == IsMissing)
+            conditions << columnName(predicate.column) + " IS NULL";
+        else if (predicate.comparison == IsPresent)
+            conditions << columnName(predicate.column) + " IS NOT NULL";
+        else
+            conditions << QString("%1 %2 ?").arg(columnName(predicate.column), QString(operators[predicate.comparison]));
+    }
+    if (!conditions.isEmpty())
+        sql += " WHERE " + conditions.join(" AND ");
+
+    if (aggregates.isEmpty()) {
+        if (ordered) {
+            sql += " ORDER BY " + columnName(orderColumn) + (sortOrder == Qt::AscendingOrder ? " ASC" : " DESC");
+            if (orderColumn != Time)
+                sql += ", time";
+        }
+        if (rowLimit >= 0)
+            sql += " LIMIT ?";
+    }
+    return sql;
+}
+
+QVariantList WeatherQuery::bindValues() const
+{
+    QVariantList values;
+    if (hasFrom)
+        values << fromTime;
+    if (hasTo)
+        values << toTime;
+    for (const Predicate &predicate : predicates) {
+        if (predicate.comparison == IsMissing || predicate.comparison == IsPresent)
+            continue;
+        values << (predicate.column == Time ? QVariant(qint64(predicate.value)) : QVariant(predicate.value));
+    }
+    if (aggregates.isEmpty() && rowLimit >= 0)
+        values << rowLimit;
+    return values;
+}
+
+QStringList WeatherQuery::columnNames() const
+{
+    QStringList names;
+    if (!aggregates.isEmpty()) {
+        for (const Aggregate &aggregate : aggregates)
+            names << QString("%1(%2)").arg(QString(functions[aggregate.function]), columnName(aggregate.column));
+        return names;
+    }
+
+    if (columns.isEmpty()) {
+        names << columnName(Time);
+        for (int column = 0; column < WeatherStore::ColumnCount; ++column)
+            names << columnName(column);
+        return names;
+    }
+
+    for (int column : columns)
+        names << columnName(column);
+    return names;
+}
+
+QueryResult WeatherQuery::run(QSqlQuery &query) const
+{
+    const QVariantList values = bindValues();
+    for (int index = 0; index < values.size(); ++index)
+        query.bindValue(index, values.at(index));
+
+    if (!query.exec()) {
+        qDebug() << "Error executing weather query:" << query.lastError().text();
+        return QueryResult();
+    }
+
+    QueryResult result(columnNames());
+    while (query.next())
+        result.appendRow(query);
+    query.finish();
+    return result;
+}
+
+QueryResult WeatherQuery::run(const WeatherStore &store) const
+{
+    // Day d stands for time d * 86400, so the bounds round up to whole days
+    qint32 firstDay = std::numeric_limits<qint32>::min();
+    qint32 lastDay = std::numeric_limits<qint32>::max();
+    if (hasFrom)
+        firstDay = WeatherRecord::dayOf(fromTime + 86399);
+    if (hasTo)
+        lastDay = WeatherRecord::dayOf(toTime + 86399) - 1;
+    const QPair<qsizetype, qsizetype> range = firstDay <= lastDay ? store.rowRange(firstDay, lastDay) : qMakePair<qsizetype, qsizetype>(0, 0);
+
+    auto valueAt = [&store](int column, qsizetype row) {
+        return column == Time ? store.day(row) * 86400.0 : double(store.value(static_cast<WeatherStore::Column>(column), row));
+    };
+    auto variantAt = [&store](int column, qsizetype row) {
+        if (column == Time)
+            return QVariant(qint64(store.day(row)) * 86400);
+        const float value = store.value(static_cast<WeatherStore::Column>(column), row);
+        return std::isnan(value) ? QVariant() : QVariant(double(value));
+    };
+
+    QueryResult result(columnNames());
+    if (!aggregates.isEmpty()) {
+        QVariantList values;
+        for (const Aggregate &aggregate : aggregates) {
+            qint64 count = 0;
+            double sum = 0.0;
+            double minimum = 0.0;
+            double maximum = 0.0;
+            if (predicates.isEmpty() && aggregate.column != Time) {
+                const WeatherStore::Aggregate total = store.aggregate(static_cast<WeatherStore::Column>(aggregate.column), range.first, range.second);
+                count = total.count;
+                sum = total.sum;
+                minimum = total.min;
+                maximum = total.max;
+            } else {
+                for (qsizetype row = range.first; row < range.second; ++row) {
+                    const bool matches = std::all_of(predicates.cbegin(), predicates.cend(), [&](const Predicate &predicate) {
+                        return compare(valueAt(predicate.column, row), predicate.comparison, predicate.value);
+                    });
+                    const double value = valueAt(aggregate.column, row);
+                    if (!matches || std::isnan(value))
+                        continue;
+                    minimum = count == 0 ? value : qMin(minimum, value);
+                    maximum = count == 0 ? value : qMax(maximum, value);
+                    sum += value;
+                    ++count;
+                }
+            }
+
+            // SQL answers NULL for everything but COUNT over no rows
+            double value = 0.0;
+            switch (aggregate.function) {
+            case Count: value = count; break;
+            case Sum: value = sum; break;
+            case Average: value = count ? sum / count : 0.0; break;
+            case Minimum: value = minimum; break;
+            case Maximum: value = maximum; break;
+            }
+
+            if (aggregate.function == Count)
+                values << count;
+            else if (count == 0)
+                values << QVariant();
+            else if (aggregate.column == Time && aggregate.function != Average)
+                values << qint64(value);
+            else
+                values << value;
+        }
+        result.appendRow(values);
+        return result;
+    }
+
+    QVector<qsizetype> rows;
+    for (qsizetype row = range.first; row < range.second; ++row) {
+        const bool matches = std::all_of(predicates.cbegin(), predicates.cend(), [&](const Predicate &predicate) {
+            return compare(valueAt(predicate.column, row), predicate.comparison, predicate.value);
+        });
+        if (matches)
+            rows.append(row);
+    }
+
+    // Rows are in time order already, a stable sort keeps time as the tie breaker like the SQL does
+    if (ordered && orderColumn == Time && sortOrder == Qt::DescendingOrder) {
+        std::reverse(rows.begin(), rows.end());
+    } else if (ordered && orderColumn != Time) {
+        const bool ascending = sortOrder == Qt::AscendingOrder;
+        std::stable_sort(rows.begin(), rows.end(), [&](qsizetype left, qsizetype right) {
+            const double leftValue = valueAt(orderColumn, left);
+            const double rightValue = valueAt(orderColumn, right);
+            // Missing values sort like NULL, first when ascending
+            if (std::isnan(leftValue) || std::isnan(rightValue))
+                return ascending ? std::isnan(leftValue) && !std::isnan(rightValue) : !std::isnan(leftValue) && std::isnan(rightValue);
+            return ascending ? leftValue < rightValue : leftValue > rightValue;
+        });
+    }
+    if (rowLimit >= 0 && rows.size() > rowLimit)
+        rows.resize(rowLimit);
+
+    QVector<int> projection = columns;
+    if (projection.isEmpty()) {
+        projection << Time;
+        for (int column = 0; column < WeatherStore::ColumnCount; ++column)
+            projection << column;
+    }
+
+    for (qsizetype row : std::as_const(rows)) {
+        QVariantList values;
+        for (int column : std::as_const(projection))
+            values << variantAt(column, row);
+        result.appendRow(values);
+    }
+    return result;
+}
+
+QString WeatherQuery::columnName(int column)
+{
+    return column == Time ? QString("time") : WeatherStore::columnName(static_cast<WeatherStore::Column>(column));
+}
@@ -0,0 +1,84 @@
+#ifndef WEATHERQUERY_H
+#define WEATHERQUERY_H
+
+#include "queryresult.h"
+#include "weatherstore.h"
+#include <QSqlQuery>
+#include <QVector>
+
+// Typed SELECT over the weather table, compiled to parameterized SQL or run against the in-memory store.
+class WeatherQuery
+{
+public:
+    // Columns are WeatherStore::Column values, Time addresses the timestamp
+    static const int Time = -1;
+
+    enum Comparison {
+        Less,
+        LessOrEqual,
+        Equal,
+        NotEqual,
+        GreaterOrEqual,
+        Greater,
+        IsMissing,
+        IsPresent
+    };
+
+    enum Function {
+        Count,
+        Sum,
+        Average,
+        Minimum,
+        Maximum
+    };
+
+    // Rows with from <= time < to
+    WeatherQuery &from(qint64 time);
+    WeatherQuery &to(qint64 time);
+    WeatherQuery &column(int column);
+    WeatherQuery &where(int column, Comparison comparison, double value = 0.0);
+    // Any aggregate turns the result into a single row, plain columns are ignored then
+    WeatherQuery &aggregate(Function function, int column);
+    WeatherQuery &orderBy(int column, Qt::SortOrder order = Qt::AscendingOrder);
+    WeatherQuery &limit(int rows);
+
+    // Values only ever appear as bind values, so equal shapes share one prepared statement
+    QString sql() const;
+    QVariantList bindValues() const;
+    QStringList columnNames() const;
+
+    // Expects a statement prepared from sql()
+    QueryResult run(QSqlQuery &query) const;
+    // The store keeps days only, a row's time is the start of its day
+    QueryResult run(const WeatherStore &store) const;
+
+    static QString columnName(int column);
+
+private:
+    struct Predicate
+    {
+        int column;
+        Comparison comparison;
+        double value;
+    };
+
+    struct Aggregate
+    {
+        Function function;
+        int column;
+    };
+
+    bool hasFrom = false;
+    bool hasTo = false;
+    qint64 fromTime = 0;
+    qint64 toTime = 0;
+    QVector<int> columns;
+    QVector<Predicate> predicates;
+    QVector<Aggregate> aggregates;
+    int orderColumn = Time;
+    Qt::SortOrder sortOrder = Qt::AscendingOrder;
+    bool ordered = false;
+    int rowLimit = -1;
+};
+
+#endif // WEATHERQUERY_H
@@ -0,0 +1,230 @@
+#include "weatherrecord.h"
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+const char *nextField(const char *begin, const char *end)
+{
+    const void *comma = std::memchr(begin, ',', end - begin);
+    return comma ? static_cast<const char *>(comma) : end;
+}
+
+int parseDigits(const char *text, int count)
+{
+    int value = 0;
+    for (int i = 0; i < count; ++i) {
+        if (text[i] < '0' || text[i] > '9')
+            throw std::runtime_error("Invalid date in line");
+        value = value * 10 + (text[i] - '0');
+    }
+    return value;
+}
+
+const double scales[WeatherRecord::FieldCount] = { 10, 10, 10, 10, 1, 1, 10, 10, 10, 1 };
+
+// Fixed layout "yyyy-MM-dd HH:mm:ss" (or ISO 'T'), the time part is optional
+qint64 parseTimestamp(const char *begin, const char *end)
+{
+    const qsizetype length = end - begin;
+    if ((length != 10 && length != 19) || begin[4] != '-' || begin[7] != '-')
+        throw std::runtime_error("Invalid date in line");
+
+    const int year = parseDigits(begin, 4);
+    const int month = parseDigits(begin + 5, 2);
+    const int day = parseDigits(begin + 8, 2);
+    int hour = 0;
+    int minute = 0;
+    int second = 0;
+    if (length == 19) {
+        if ((begin[10] != ' ' && begin[10] != 'T') || begin[13] != ':' || begin[16] != ':')
+            throw std::runtime_error("Invalid date in line");
+        hour = parseDigits(begin + 11, 2);
+        minute = parseDigits(begin + 14, 2);
+        second = parseDigits(begin + 17, 2);
+    }
+
+    if (!QDate::isValid(year, month, day) || !QTime::isValid(hour, minute, second))
+        throw std::runtime_error("Invalid date in line");
+    return WeatherRecord::daysFromCivil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second;
+}
+
+// Plain decimal notation as written by Meteostat
+double parseNumber(const char *begin, const char *end)
+{
+    static const double powersOfTen[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+                                          1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18 };
+
+    bool negative = *begin == '-';
+    if (negative || *begin == '+')
+        ++begin;
+
+    qint64 mantissa = 0;
+    int digits = 0;
+    int scale = 0;
+    bool fraction = false;
+    for (; begin != end; ++begin) {
+        const char c = *begin;
+        if (c >= '0' && c <= '9') {
+            if (digits < 18) {
+                mantissa = mantissa * 10 + (c - '0');
+                ++digits;
+                if (fraction)
+                    ++scale;
+            } else if (!fraction) {
+                throw std::runtime_error("Number out of range in line");
+            }
+        } else if (c == '.' && !fraction) {
+            fraction = true;
+        } else {
+            throw std::runtime_error("Invalid number in line");
+        }
+    }
+
+    if (digits == 0)
+        throw std::runtime_error("Invalid number in line");
+
+    const double value = mantissa / powersOfTen[scale];
+    return negative ? -value : value;
+}
+}
+
+WeatherRecord WeatherRecord::fromCsv(const char *begin, const char *end)
+{
+    const char *fields[FieldCount + 2];
+    int count = 0;
+    fields[0] = begin;
+    for (const char *field = begin; count < FieldCount + 1; ) {
+        const char *fieldEnd = nextField(field, end);
+        fields[++count] = fieldEnd;
+        if (fieldEnd == end)
+            break;
+        field = fieldEnd + 1;
+    }
+    if (count != FieldCount + 1)
+        throw std::runtime_error("Too few fields in line");
+    if (fields[FieldCount + 1] != end)
+        throw std::runtime_error("Too many fields in line");
+
+    // fields[i] is the comma in front of value i, the date runs from begin to fields[1]
+    WeatherRecord record;
+    record.timestamp = parseTimestamp(fields[0], fields[1]);
+    record.missing = 0;
+    for (int field = 0; field < FieldCount; ++field) {
+        const char *fieldBegin = fields[field + 1] + 1;
+        const char *fieldEnd = fields[field + 2];
+        if (fieldBegin == fieldEnd)
+            record.setMissing(static_cast<Field>(field));
+        else
+            record.setValue(static_cast<Field>(field), parseNumber(fieldBegin, fieldEnd));
+    }
+    return record;
+}
+
+WeatherRecord WeatherRecord::fromQuery(const QSqlQuery &query, int firstColumn)
+{
+    WeatherRecord record;
+    record.timestamp = query.value(firstColumn).toLongLong();
+    record.missing = 0;
+    for (int field = 0; field < FieldCount; ++field) {
+        const QVariant value = query.value(firstColumn + 1 + field);
+        if (value.isNull())
+            record.setMissing(static_cast<Field>(field));
+        else
+            record.setValue(static_cast<Field>(field), value.toDouble());
+    }
+    return record;
+}
+
+QString WeatherRecord::columnList()
+{
+    return "time, averageTemperature, minimumTemperature, maximunTemperature, precipitation, snow, "
+           "windDirection, windSpeed, windPeakGust, airPressure, sunshineDuration";
+}
+
+bool WeatherRecord::isMissing(Field field) const
+{
+    return missing & (1u << field);
+}
+
+double WeatherRecord::value(Field field) const
+{
+    return isMissing(field) ? std::numeric_limits<double>::quiet_NaN() : values[field] / scales[field];
+}
+
+QVariant WeatherRecord::variant(Field field) const
+{
+    if (isMissing(field))
+        return QVariant();
+    if (scales[field] == 1)
+        return static_cast<int>(values[field]);
+    return static_cast<float>(values[field] / scales[field]);
+}
+
+void WeatherRecord::setValue(Field field, double value)
+{
+    const double scaled = std::round(value * scales[field]);
+    if (!(scaled >= std::numeric_limits<qint16>::min() && scaled <= std::numeric_limits<qint16>::max()))
+        throw std::runtime_error("Value out of range in line");
+
+    values[field] = static_cast<qint16>(scaled);
+    missing &= ~(1u << field);
+}
+
+void WeatherRecord::setMissing(Field field)
+{
+    values[field] = 0;
+    missing |= 1u << field;
+}
+
+qint32 WeatherRecord::epochDay() const
+{
+    return dayOf(timestamp);
+}
+
+QString WeatherRecord::isoDate() const
+{
+    int year, month, day;
+    civilFromDays(epochDay(), year, month, day);
+    const qint64 seconds = timestamp - qint64(epochDay()) * 86400;
+    return QString::asprintf("%04d-%02d-%02dT%02d:%02d:%02d", year, month, day,
+                             int(seconds / 3600), int(seconds / 60 % 60), int(seconds % 60));
+}
+
+QDateTime WeatherRecord::dateTime() const
+{
+    int year, month, day;
+    civilFromDays(epochDay(), year, month, day);
+    const int seconds = static_cast<int>(timestamp - qint64(epochDay()) * 86400);
+    return QDateTime(QDate(year, month, day), QTime(0, 0).addSecs(seconds));
+}
+
+qint32 WeatherRecord::dayOf(qint64 timestamp)
+{
+    return static_cast<qint32>(timestamp >= 0 ? timestamp / 86400 : (timestamp - 86399) / 86400);
+}
+
+// Howard Hinnant's proleptic Gregorian day arithmetic
+qint64 WeatherRecord::daysFromCivil(int year, int month, int day)
+{
+    year -= month <= 2;
+    const qint64 era = (year >= 0 ? year : year - 399) / 400;
+    const unsigned yearOfEra = static_cast<unsigned>(year - era * 400);
+    const unsigned dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    const unsigned dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + static_cast<qint64>(dayOfEra) - 719468;
+}
+
+void WeatherRecord::civilFromDays(qint64 days, int &year, int &month, int &day)
+{
+    days += 719468;
+    const qint64 era = (days >= 0 ? days : days - 146096) / 146097;
+    const unsigned dayOfEra = static_cast<unsigned>(days - era * 146097);
+    const unsigned yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    const unsigned dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    const unsigned monthIndex = (5 * dayOfYear + 2) / 153;
+    day = static_cast<int>(dayOfYear - (153 * monthIndex + 2) / 5 + 1);
+    month = static_cast<int>(monthIndex < 10 ? monthIndex + 3 : monthIndex - 9);
+    year = static_cast<int>(yearOfEra + era * 400 + (month <= 2));
+}
@@ -0,0 +1,55 @@
+#ifndef WEATHERRECORD_H
+#define WEATHERRECORD_H
+
+#include <QDateTime>
+#include <QSqlQuery>
+#include <QString>
+#include <QVariant>
+#include <type_traits>
+
+// Compact observation: integer timestamp, fixed-point measurements and a bit per missing field.
+struct WeatherRecord
+{
+    enum Field {
+        AverageTemperature,
+        MinimumTemperature,
+        MaximunTemperature,
+        Precipitation,
+        Snow,
+        WindDirection,
+        WindSpeed,
+        WindPeakGust,
+        AirPressure,
+        SunshineDuration,
+        FieldCount
+    };
+
+    qint64 timestamp;
+    qint16 values[FieldCount];
+    quint16 missing;
+
+    static WeatherRecord fromCsv(const char *begin, const char *end);
+    // Expects the columns in columnList() order, starting at firstColumn
+    static WeatherRecord fromQuery(const QSqlQuery &query, int firstColumn = 0);
+    static QString columnList();
+
+    bool isMissing(Field field) const;
+    double value(Field field) const;
+    QVariant variant(Field field) const;
+    void setValue(Field field, double value);
+    void setMissing(Field field);
+
+    qint32 epochDay() const;
+    QString isoDate() const;
+    QDateTime dateTime() const;
+
+    static qint32 dayOf(qint64 timestamp);
+    static qint64 daysFromCivil(int year, int month, int day);
+    static void civilFromDays(qint64 days, int &year, int &month, int &day);
+};
+
+static_assert(std::is_trivially_copyable<WeatherRecord>::value, "WeatherRecord must stay memcpy-able");
+static_assert(sizeof(WeatherRecord) == 32, "WeatherRecord is expected to be 32 bytes");
+Q_DECLARE_TYPEINFO(WeatherRecord, Q_PRIMITIVE_TYPE);
+
+#endif // WEATHERRECORD_H
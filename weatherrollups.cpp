@@ -0,0 +1,240 @@
+#include "weatherrollups.h"
+#include <QDebug>
+#include <QSqlError>
+#include <QSqlQuery>
+
+namespace {
+const char *const suffixes[] = { "Count", "Sum", "Minimum", "Maximum" };
+
+QString statisticsColumns()
+{
+    QStringList columns;
+    for (int column = 0; column < WeatherStore::ColumnCount; ++column) {
+        const QString name = WeatherStore::columnName(static_cast<WeatherStore::Column>(column));
+        for (const char *suffix : suffixes)
+            columns << name + suffix;
+    }
+    return columns.join(", ");
+}
+
+// Reads rows, then count/sum/min/max per column starting at firstColumn
+WeatherStatistics statisticsFrom(const QSqlQuery &query, int firstColumn)
+{
+    WeatherStatistics statistics;
+    statistics.setRowCount(query.value(firstColumn).toLongLong());
+    for (int column = 0; column < WeatherStore::ColumnCount; ++column) {
+        const int field = firstColumn + 1 + column * 4;
+        WeatherStatistics::ColumnStatistics columnStatistics;
+        columnStatistics.count = query.value(field).toLongLong();
+        columnStatistics.sum = query.value(field + 1).toDouble();
+        columnStatistics.minimum = query.value(field + 2).toDouble();
+        columnStatistics.maximum = query.value(field + 3).toDouble();
+        statistics.setColumn(static_cast<WeatherStore::Column>(column), columnStatistics);
+    }
+    return statistics;
+}
+
+QString upsertSql(WeatherRollups::Level level)
+{
+    QStringList placeholders = { "?", "?" };
+    QStringList updates = { "rows = rows + excluded.rows" };
+    for (int column = 0; column < WeatherStore::ColumnCount; ++column) {
+        const QString name = WeatherStore::columnName(static_cast<WeatherStore::Column>(column));
+        placeholders << "?" << "?" << "?" << "?";
+        updates << QString("%1Count = %1Count + excluded.%1Count").arg(name)
+                << QString("%1Sum = %1Sum + excluded.%1Sum").arg(name)
+                << QString("%1Minimum = COALESCE(MIN(%1Minimum, excluded.%1Minimum), %1Minimum, excluded.%1Minimum)").arg(name)
+                << QString("%1Maximum = COALESCE(MAX(%1Maximum, excluded.%1Maximum), %1Maximum, excluded.%1Maximum)").arg(name);
+    }
+
+    return QString("INSERT INTO %1 (start, rows, %2) VALUES (%3) ON CONFLICT(start) DO UPDATE SET %4")
+        .arg(WeatherRollups::tableName(level), statisticsColumns(), placeholders.join(", "), updates.join(", "));
+}
+}
+
+void WeatherRollups::add(const WeatherRecord &record)
+{
+    for (int level = 0; level < LevelCount; ++level)
+        pending[level][bucketStart(static_cast<Level>(level), record.timestamp)].add(record);
+}
+
+bool WeatherRollups::save(const QSqlDatabase &db)
+{
+    for (int level = 0; level < LevelCount; ++level) {
+        if (pending[level].isEmpty())
+            continue;
+
+        QSqlQuery query(db);
+        if (!query.prepare(upsertSql(static_cast<Level>(level)))) {
+            qDebug() << "Error preparing rollup update:" << query.lastError().text();
+            return false;
+        }
+
+        for (auto bucket = pending[level].cbegin(); bucket != pending[level].cend(); ++bucket) {
+            const WeatherStatistics &statistics = bucket.value();
+            int field = 0;
+            query.bindValue(field++, bucket.key());
+            query.bindValue(field++, statistics.rowCount());
+            for (int column = 0; column < WeatherStore::ColumnCount; ++column) {
+                const WeatherStatistics::ColumnStatistics &columnStatistics = statistics.column(static_cast<WeatherStore::Column>(column));
+                const bool empty = columnStatistics.count == 0;
+                query.bindValue(field++, columnStatistics.count);
+                query.bindValue(field++, columnStatistics.sum);
+                query.bindValue(field++, empty ? QVariant() : QVariant(columnStatistics.minimum));
+                query.bindValue(field++, empty ? QVariant() : QVariant(columnStatistics.maximum));
+            }
+
+            if (!query.exec()) {
+                qDebug() << "Error updating rollup:" << query.lastError().text();
+                return false;
+            }
+        }
+        pending[level].clear();
+    }
+
+    return true;
+}
+
+WeatherRollups::Level WeatherRollups::levelFor(qint64 from, qint64 to, int maxBuckets)
+{
+    const double days = qMax<qint64>(to - from, 0) / 86400.0;
+    if (days <= maxBuckets)
+        return Day;
+    if (days / 30.44 <= maxBuckets)
+        return Month;
+    return Year;
+}
+
+QVector<WeatherRollups::Bucket> WeatherRollups::series(const QSqlDatabase &db, Level level, qint64 from, qint64 to)
+{
+    QVector<Bucket> buckets;
+
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    query.prepare(QString("SELECT start, rows, %1 FROM %2 WHERE start >= ? AND start < ? ORDER BY start")
+                      .arg(statisticsColumns(), tableName(level)));
+    query.addBindValue(bucketStart(level, from));
+    query.addBindValue(to);
+    if (!query.exec()) {
+        qDebug() << "Error reading rollup:" << query.lastError().text();
+        return buckets;
+    }
+
+    while (query.next()) {
+        Bucket bucket;
+        bucket.start = query.value(0).toLongLong();
+        bucket.statistics = statisticsFrom(query, 1);
+        buckets.append(bucket);
+    }
+    return buckets;
+}
+
+WeatherStatistics WeatherRollups::aggregate(const QSqlDatabase &db, qint64 from, qint64 to)
+{
+    QStringList aggregates = { "SUM(rows)" };
+    for (int column = 0; column < WeatherStore::ColumnCount; ++column) {
+        const QString name = WeatherStore::columnName(static_cast<WeatherStore::Column>(column));
+        aggregates << QString("SUM(%1Count), TOTAL(%1Sum), MIN(%1Minimum), MAX(%1Maximum)").arg(name);
+    }
+
+    WeatherStatistics result;
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    const QVector<Span> spans = cover(from, to);
+    for (const Span &span : spans) {
+        query.prepare(QString("SELECT %1 FROM %2 WHERE start >= ? AND start < ?").arg(aggregates.join(", "), tableName(span.level)));
+        query.addBindValue(span.from);
+        query.addBindValue(span.to);
+        if (!query.exec() || !query.next()) {
+            qDebug() << "Error aggregating rollup:" << query.lastError().text();
+            continue;
+        }
+        result.merge(statisticsFrom(query, 0));
+    }
+    return result;
+}
+
+QVector<WeatherRollups::Span> WeatherRollups::cover(qint64 from, qint64 to)
+{
+    // Greedy tiling: a year where a whole year fits, else a month, else a day
+    QVector<Span> spans;
+    qint64 cursor = bucketStart(Day, from) < from ? nextBucketStart(Day, from) : from;
+    const qint64 end = bucketStart(Day, to);
+    while (cursor < end) {
+        Level level = Day;
+        for (int candidate = Year; candidate > Day; --candidate) {
+            const Level coarser = static_cast<Level>(candidate);
+            if (bucketStart(coarser, cursor) == cursor && nextBucketStart(coarser, cursor) <= end) {
+                level = coarser;
+                break;
+            }
+        }
+
+        const qint64 next = nextBucketStart(level, cursor);
+        if (!spans.isEmpty() && spans.last().level == level && spans.last().to == cursor)
+            spans.last().to = next;
+        else
+            spans.append({ level, cursor, next });
+        cursor = next;
+    }
+    return spans;
+}
+
+QString WeatherRollups::tableName(Level level)
+{
+    switch (level) {
+    case Day: return "weather_rollup_day";
+    case Month: return "weather_rollup_month";
+    case Year: return "weather_rollup_year";
+    default: return QString();
+    }
+}
+
+qint64 WeatherRollups::bucketStart(Level level, qint64 timestamp)
+{
+    const qint32 day = WeatherRecord::dayOf(timestamp);
+    if (level == Day)
+        return qint64(day) * 86400;
+
+    int year, month, dayOfMonth;
+    WeatherRecord::civilFromDays(day, year, month, dayOfMonth);
+    return WeatherRecord::daysFromCivil(year, level == Year ? 1 : month, 1) * 86400;
+}
+
+qint64 WeatherRollups::nextBucketStart(Level level, qint64 start)
+{
+    if (level == Day)
+        return bucketStart(Day, start) + 86400;
+
+    int year, month, day;
+    WeatherRecord::civilFromDays(WeatherRecord::dayOf(start), year, month, day);
+    if (level == Year)
+        return WeatherRecord::daysFromCivil(year + 1, 1, 1) * 86400;
+    return month == 12 ? WeatherRecord::daysFromCivil(year + 1, 1, 1) * 86400
+                       : WeatherRecord::daysFromCivil(year, month + 1, 1) * 86400;
+}
+
+// Creates the tables and fills them from the rows already in weather
+QStringList WeatherRollups::createStatements()
+{
+    static const char *const modifiers[] = { "start of day", "start of month", "start of year" };
+
+    QStringList definitions = { "start INTEGER PRIMARY KEY", "rows INTEGER" };
+    QStringList aggregates = { "COUNT(*)" };
+    for (int column = 0; column < WeatherStore::ColumnCount; ++column) {
+        const QString name = WeatherStore::columnName(static_cast<WeatherStore::Column>(column));
+        definitions << name + "Count INTEGER" << name + "Sum REAL" << name + "Minimum REAL" << name + "Maximum REAL";
+        aggregates << QString("COUNT(%1), TOTAL(%1), MIN(%1), MAX(%1)").arg(name);
+    }
+
+    QStringList statements;
+    for (int level = 0; level < LevelCount; ++level) {
+        const QString table = tableName(static_cast<Level>(level));
+        statements << QString("CREATE TABLE IF NOT EXISTS %1 (%2)").arg(table, definitions.join(", "))
+                   << QString("INSERT OR REPLACE INTO %1 (start, rows, %2) "
+                              "SELECT CAST(strftime('%s', time, 'unixepoch', '%3') AS INTEGER) AS bucket, %4 "
+                              "FROM weather GROUP BY bucket")
+                          .arg(table, statisticsColumns(), QString(modifiers[level]), aggregates.join(", "));
+    }
+    return statements;
+}
@@ -0,0 +1,57 @@
+#ifndef WEATHERROLLUPS_H
+#define WEATHERROLLUPS_H
+
+#include "weatherrecord.h"
+#include "weatherstatistics.h"
+#include <QHash>
+#include <QSqlDatabase>
+#include <QStringList>
+#include <QVector>
+
+// Day, month and year buckets of count/sum/min/max per column, kept in weather_rollup_* tables.
+class WeatherRollups
+{
+public:
+    enum Level {
+        Day,
+        Month,
+        Year,
+        LevelCount
+    };
+
+    struct Bucket
+    {
+        qint64 start = 0;
+        WeatherStatistics statistics;
+    };
+
+    // Consecutive buckets of one level covering [from, to)
+    struct Span
+    {
+        Level level;
+        qint64 from;
+        qint64 to;
+    };
+
+    // Ingest side: accumulate inserted rows, then fold them into the tables inside the open transaction
+    void add(const WeatherRecord &record);
+    bool save(const QSqlDatabase &db);
+
+    // Picks the finest level that still gives at most maxBuckets buckets over [from, to)
+    static Level levelFor(qint64 from, qint64 to, int maxBuckets);
+    static QVector<Bucket> series(const QSqlDatabase &db, Level level, qint64 from, qint64 to);
+    // Whole days in [from, to), answered from the coarsest buckets that tile the range
+    static WeatherStatistics aggregate(const QSqlDatabase &db, qint64 from, qint64 to);
+    // Whole days in [from, to) as the fewest spans, a year where a whole year fits, else a month, else a day
+    static QVector<Span> cover(qint64 from, qint64 to);
+
+    static QString tableName(Level level);
+    static qint64 bucketStart(Level level, qint64 timestamp);
+    static qint64 nextBucketStart(Level level, qint64 start);
+    static QStringList createStatements();
+
+private:
+    QHash<qint64, WeatherStatistics> pending[LevelCount];
+};
+
+#endif // WEATHERROLLUPS_H
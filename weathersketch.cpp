@@ -0,0 +1,239 @@
+#include "weathersketch.h"
+#include <QDataStream>
+#include <QIODevice>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+const quint8 formatVersion = 1;
+const double pi = 3.14159265358979323846;
+
+// Arcsine scale: centroids are small near the extremes, where P1 and P99 are read, and large in the middle
+double scale(double q, int compression)
+{
+    return compression / (2.0 * pi) * std::asin(qBound(-1.0, 2.0 * q - 1.0, 1.0));
+}
+}
+
+WeatherSketch::WeatherSketch(WeatherStore::Column column, int compression)
+    : valueColumn(column)
+    , compression(qMax(10, compression))
+    , total(0)
+    , minimumValue(0.0)
+    , maximumValue(0.0)
+    , bins(layout(column).bins + 2, 0)
+{
+}
+
+void WeatherSketch::add(double value)
+{
+    if (std::isnan(value))
+        return;
+
+    minimumValue = total == 0 ? value : qMin(minimumValue, value);
+    maximumValue = total == 0 ? value : qMax(maximumValue, value);
+    ++total;
+
+    const Layout bounds = layout();
+    const double bin = std::floor((value - bounds.low) / bounds.width) + 1;
+    ++bins[qsizetype(qBound(0.0, bin, double(bounds.bins + 1)))];
+
+    buffer.append({ value, 1.0 });
+    if (buffer.size() >= compression * 5)
+        compress();
+}
+
+void WeatherSketch::merge(const WeatherSketch &other)
+{
+    if (other.total == 0)
+        return;
+
+    minimumValue = total == 0 ? other.minimumValue : qMin(minimumValue, other.minimumValue);
+    maximumValue = total == 0 ? other.maximumValue : qMax(maximumValue, other.maximumValue);
+    total += other.total;
+
+    // Sketches of the same column share the layout, so bins add up one to one
+    for (qsizetype bin = 0; bin < bins.size() && bin < other.bins.size(); ++bin)
+        bins[bin] += other.bins.at(bin);
+
+    buffer += other.centroids;
+    buffer += other.buffer;
+    if (buffer.size() >= compression * 5)
+        compress();
+}
+
+WeatherStore::Column WeatherSketch::column() const
+{
+    return valueColumn;
+}
+
+qint64 WeatherSketch::count() const
+{
+    return total;
+}
+
+double WeatherSketch::minimum() const
+{
+    return minimumValue;
+}
+
+double WeatherSketch::maximum() const
+{
+    return maximumValue;
+}
+
+double WeatherSketch::quantile(double q) const
+{
+    compress();
+    if (centroids.isEmpty())
+        return std::numeric_limits<double>::quiet_NaN();
+
+    // Each centroid's weight is centred on its mean, the outer halves run to the exact extremes
+    const double index = qBound(0.0, q, 1.0) * total;
+    const Centroid &first = centroids.first();
+    if (index < first.weight / 2)
+        return minimumValue + (first.mean - minimumValue) * index / (first.weight / 2);
+
+    double before = 0.0;
+    for (qsizetype i = 0; i + 1 < centroids.size(); ++i) {
+        const Centroid &left = centroids.at(i);
+        const Centroid &right = centroids.at(i + 1);
+        const double leftCenter = before + left.weight / 2;
+        const double rightCenter = before + left.weight + right.weight / 2;
+        if (index < rightCenter)
+            return left.mean + (right.mean - left.mean) * (index - leftCenter) / (rightCenter - leftCenter);
+        before += left.weight;
+    }
+
+    const Centroid &last = centroids.last();
+    const double lastCenter = total - last.weight / 2;
+    return qMin(maximumValue, last.mean + (maximumValue - last.mean) * (index - lastCenter) / (last.weight / 2));
+}
+
+const QVector<qint64> &WeatherSketch::histogram() const
+{
+    return bins;
+}
+
+WeatherSketch::Layout WeatherSketch::layout() const
+{
+    return layout(valueColumn);
+}
+
+WeatherSketch::Layout WeatherSketch::layout(WeatherStore::Column column)
+{
+    switch (column) {
+    case WeatherStore::AverageTemperature:
+    case WeatherStore::MinimumTemperature:
+    case WeatherStore::MaximunTemperature: return { -50.0, 1.0, 100 };
+    case WeatherStore::Precipitation: return { 0.0, 1.0, 100 };
+    case WeatherStore::Snow: return { 0.0, 10.0, 100 };
+    case WeatherStore::WindDirection: return { 0.0, 10.0, 36 };
+    case WeatherStore::WindSpeed:
+    case WeatherStore::WindPeakGust: return { 0.0, 2.0, 100 };
+    case WeatherStore::AirPressure: return { 950.0, 1.0, 100 };
+    case WeatherStore::SunshineDuration: return { 0.0, 15.0, 96 };
+    default: return { 0.0, 1.0, 100 };
+    }
+}
+
+QByteArray WeatherSketch::toBytes() const
+{
+    compress();
+
+    QByteArray bytes;
+    QDataStream out(&bytes, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_15);
+    out << formatVersion << qint32(compression) << total << minimumValue << maximumValue;
+
+    out << quint32(centroids.size());
+    for (const Centroid &centroid : std::as_const(centroids))
+        out << centroid.mean << centroid.weight;
+
+    // Bins are written sparsely, a day touches only a handful of them
+    out << quint32(std::count_if(bins.cbegin(), bins.cend(), [](qint64 count) { return count != 0; }));
+    for (qsizetype bin = 0; bin < bins.size(); ++bin) {
+        if (bins.at(bin) != 0)
+            out << quint16(bin) << bins.at(bin);
+    }
+    return bytes;
+}
+
+bool WeatherSketch::fromBytes(WeatherStore::Column column, const QByteArray &bytes, WeatherSketch &sketch)
+{
+    QDataStream in(bytes);
+    in.setVersion(QDataStream::Qt_5_15);
+
+    quint8 version = 0;
+    qint32 compression = 0;
+    in >> version >> compression;
+    if (in.status() != QDataStream::Ok || version != formatVersion)
+        return false;
+
+    WeatherSketch result(column, compression);
+    quint32 centroidCount = 0;
+    in >> result.total >> result.minimumValue >> result.maximumValue >> centroidCount;
+    if (in.status() != QDataStream::Ok || centroidCount > quint32(bytes.size()))
+        return false;
+
+    double weight = 0.0;
+    result.centroids.resize(centroidCount);
+    for (Centroid &centroid : result.centroids) {
+        in >> centroid.mean >> centroid.weight;
+        weight += centroid.weight;
+    }
+
+    quint32 usedBins = 0;
+    in >> usedBins;
+    for (quint32 used = 0; used < usedBins && in.status() == QDataStream::Ok; ++used) {
+        quint16 bin = 0;
+        qint64 count = 0;
+        in >> bin >> count;
+        if (bin >= result.bins.size())
+            return false;
+        result.bins[bin] = count;
+    }
+
+    if (in.status() != QDataStream::Ok || qint64(std::llround(weight)) != result.total)
+        return false;
+    sketch = result;
+    return true;
+}
+
+void WeatherSketch::compress() const
+{
+    if (buffer.isEmpty())
+        return;
+
+    QVector<Centroid> all = centroids + buffer;
+    buffer.clear();
+    std::sort(all.begin(), all.end(), [](const Centroid &left, const Centroid &right) {
+        return left.mean < right.mean;
+    });
+
+    double totalWeight = 0.0;
+    for (const Centroid &centroid : std::as_const(all))
+        totalWeight += centroid.weight;
+
+    // One pass: neighbours join while the merged centroid spans at most one unit of the scale
+    QVector<Centroid> merged;
+    merged.reserve(compression * 2);
+    Centroid current = all.first();
+    double before = 0.0;
+    for (qsizetype i = 1; i < all.size(); ++i) {
+        const Centroid &next = all.at(i);
+        const double q0 = before / totalWeight;
+        const double q2 = (before + current.weight + next.weight) / totalWeight;
+        if (scale(q2, compression) - scale(q0, compression) <= 1.0) {
+            current.weight += next.weight;
+            current.mean += (next.mean - current.mean) * next.weight / current.weight;
+        } else {
+            before += current.weight;
+            merged.append(current);
+            current = next;
+        }
+    }
+    merged.append(current);
+    centroids = merged;
+}
@@ -0,0 +1,62 @@
+#ifndef WEATHERSKETCH_H
+#define WEATHERSKETCH_H
+
+#include "weatherstore.h"
+#include <QByteArray>
+#include <QVector>
+
+// Mergeable summary of one column's distribution: a t-digest for quantiles and a fixed-bin histogram.
+class WeatherSketch
+{
+public:
+    // Histogram bins of equal width from low, plus one bin below and one above
+    struct Layout
+    {
+        double low;
+        double width;
+        int bins;
+    };
+
+    explicit WeatherSketch(WeatherStore::Column column = WeatherStore::AverageTemperature, int compression = 100);
+
+    void add(double value);
+    // The result keeps this sketch's compression
+    void merge(const WeatherSketch &other);
+
+    WeatherStore::Column column() const;
+    qint64 count() const;
+    double minimum() const;
+    double maximum() const;
+    // q in [0, 1], NaN for an empty sketch; the rank error shrinks towards the tails
+    double quantile(double q) const;
+
+    // Bin 0 counts values below layout().low, the last bin values beyond the top
+    const QVector<qint64> &histogram() const;
+    Layout layout() const;
+    static Layout layout(WeatherStore::Column column);
+
+    QByteArray toBytes() const;
+    // Fails on data that was not written by toBytes for the same column
+    static bool fromBytes(WeatherStore::Column column, const QByteArray &bytes, WeatherSketch &sketch);
+
+private:
+    struct Centroid
+    {
+        double mean;
+        double weight;
+    };
+
+    // Folds the buffer into the centroids, each centroid covering at most one unit of the arcsine scale
+    void compress() const;
+
+    WeatherStore::Column valueColumn;
+    int compression;
+    qint64 total;
+    double minimumValue;
+    double maximumValue;
+    mutable QVector<Centroid> centroids;
+    mutable QVector<Centroid> buffer;
+    QVector<qint64> bins;
+};
+
+#endif // WEATHERSKETCH_H
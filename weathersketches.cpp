@@ -0,0 +1,179 @@
+#include "weathersketches.h"
+#include <QDebug>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <algorithm>
+#include <iterator>
+
+namespace {
+const int backfillRows = 65536;
+
+// Day buckets are many and small, a coarser digest keeps each to a few hundred bytes
+int compressionFor(WeatherRollups::Level level)
+{
+    return level == WeatherRollups::Day ? 25 : 100;
+}
+}
+
+const WeatherStore::Column WeatherSketches::columns[ColumnCount] = {
+    WeatherStore::AverageTemperature,
+    WeatherStore::WindSpeed,
+    WeatherStore::Precipitation
+};
+
+bool WeatherSketches::isSketched(WeatherStore::Column column)
+{
+    return std::find(std::cbegin(columns), std::cend(columns), column) != std::cend(columns);
+}
+
+void WeatherSketches::add(const WeatherRecord &record)
+{
+    for (int index = 0; index < ColumnCount; ++index) {
+        const WeatherRecord::Field field = static_cast<WeatherRecord::Field>(columns[index]);
+        if (record.isMissing(field))
+            continue;
+
+        const double value = record.value(field);
+        for (int level = 0; level < WeatherRollups::LevelCount; ++level) {
+            const qint64 start = WeatherRollups::bucketStart(static_cast<WeatherRollups::Level>(level), record.timestamp);
+            auto sketch = pending[level][index].find(start);
+            if (sketch == pending[level][index].end())
+                sketch = pending[level][index].insert(start, WeatherSketch(columns[index], compressionFor(static_cast<WeatherRollups::Level>(level))));
+            sketch->add(value);
+        }
+    }
+}
+
+bool WeatherSketches::save(const QSqlDatabase &db)
+{
+    QSqlQuery select(db);
+    QSqlQuery upsert(db);
+    for (int level = 0; level < WeatherRollups::LevelCount; ++level) {
+        const QString table = tableName(static_cast<WeatherRollups::Level>(level));
+        if (!select.prepare(QString("SELECT sketch FROM %1 WHERE start = ? AND name = ?").arg(table))
+            || !upsert.prepare(QString("INSERT OR REPLACE INTO %1 (start, name, sketch) VALUES (?, ?, ?)").arg(table))) {
+            qDebug() << "Error preparing sketch update:" << select.lastError().text() << upsert.lastError().text();
+            return false;
+        }
+
+        for (int index = 0; index < ColumnCount; ++index) {
+            const QString name = WeatherStore::columnName(columns[index]);
+            for (auto bucket = pending[level][index].cbegin(); bucket != pending[level][index].cend(); ++bucket) {
+                // Buckets already on disk absorb the new rows, the stored sketch keeps its compression
+                WeatherSketch sketch = bucket.value();
+                select.bindValue(0, bucket.key());
+                select.bindValue(1, name);
+                if (select.exec() && select.next()) {
+                    WeatherSketch stored;
+                    if (WeatherSketch::fromBytes(columns[index], select.value(0).toByteArray(), stored)) {
+                        stored.merge(sketch);
+                        sketch = stored;
+                    } else {
+                        qDebug() << "Replacing unreadable sketch in" << table << "at" << bucket.key();
+                    }
+                }
+                select.finish();
+
+                upsert.bindValue(0, bucket.key());
+                upsert.bindValue(1, name);
+                upsert.bindValue(2, sketch.toBytes());
+                if (!upsert.exec()) {
+                    qDebug() << "Error updating sketch:" << upsert.lastError().text();
+                    return false;
+                }
+            }
+            pending[level][index].clear();
+        }
+    }
+
+    return true;
+}
+
+QVector<WeatherSketches::Bucket> WeatherSketches::series(const QSqlDatabase &db, WeatherRollups::Level level, WeatherStore::Column column, qint64 from, qint64 to)
+{
+    QVector<Bucket> buckets;
+
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    query.prepare(QString("SELECT start, sketch FROM %1 WHERE name = ? AND start >= ? AND start < ? ORDER BY start").arg(tableName(level)));
+    query.addBindValue(WeatherStore::columnName(column));
+    query.addBindValue(WeatherRollups::bucketStart(level, from));
+    query.addBindValue(to);
+    if (!query.exec()) {
+        qDebug() << "Error reading sketches:" << query.lastError().text();
+        return buckets;
+    }
+
+    while (query.next()) {
+        Bucket bucket;
+        bucket.start = query.value(0).toLongLong();
+        if (WeatherSketch::fromBytes(column, query.value(1).toByteArray(), bucket.sketch))
+            buckets.append(bucket);
+    }
+    return buckets;
+}
+
+WeatherSketch WeatherSketches::aggregate(const QSqlDatabase &db, WeatherStore::Column column, qint64 from, qint64 to)
+{
+    WeatherSketch result(column);
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    const QVector<WeatherRollups::Span> spans = WeatherRollups::cover(from, to);
+    for (const WeatherRollups::Span &span : spans) {
+        query.prepare(QString("SELECT sketch FROM %1 WHERE name = ? AND start >= ? AND start < ?").arg(tableName(span.level)));
+        query.addBindValue(WeatherStore::columnName(column));
+        query.addBindValue(span.from);
+        query.addBindValue(span.to);
+        if (!query.exec()) {
+            qDebug() << "Error aggregating sketches:" << query.lastError().text();
+            continue;
+        }
+
+        WeatherSketch sketch;
+        while (query.next()) {
+            if (WeatherSketch::fromBytes(column, query.value(0).toByteArray(), sketch))
+                result.merge(sketch);
+        }
+    }
+    return result;
+}
+
+QString WeatherSketches::tableName(WeatherRollups::Level level)
+{
+    switch (level) {
+    case WeatherRollups::Day: return "weather_sketch_day";
+    case WeatherRollups::Month: return "weather_sketch_month";
+    case WeatherRollups::Year: return "weather_sketch_year";
+    default: return QString();
+    }
+}
+
+QStringList WeatherSketches::createStatements()
+{
+    QStringList statements;
+    for (int level = 0; level < WeatherRollups::LevelCount; ++level) {
+        statements << QString("CREATE TABLE IF NOT EXISTS %1 (start INTEGER, name TEXT, sketch BLOB, PRIMARY KEY (start, name)) WITHOUT ROWID")
+                          .arg(tableName(static_cast<WeatherRollups::Level>(level)));
+    }
+    return statements;
+}
+
+bool WeatherSketches::backfill(const QSqlDatabase &db)
+{
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    if (!query.exec("SELECT " + WeatherRecord::columnList() + " FROM weather ORDER BY time")) {
+        qDebug() << "Error reading rows for sketches:" << query.lastError().text();
+        return false;
+    }
+
+    // Saved in slices so memory stays bounded on large tables
+    WeatherSketches sketches;
+    qint64 rows = 0;
+    while (query.next()) {
+        sketches.add(WeatherRecord::fromQuery(query));
+        if (++rows % backfillRows == 0 && !sketches.save(db))
+            return false;
+    }
+    return sketches.save(db);
+}
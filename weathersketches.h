@@ -0,0 +1,43 @@
+#ifndef WEATHERSKETCHES_H
+#define WEATHERSKETCHES_H
+
+#include "weatherrecord.h"
+#include "weatherrollups.h"
+#include "weathersketch.h"
+#include <QHash>
+#include <QSqlDatabase>
+#include <QStringList>
+#include <QVector>
+
+// Day, month and year quantile and histogram sketches of the skewed columns, kept in weather_sketch_* tables.
+class WeatherSketches
+{
+public:
+    struct Bucket
+    {
+        qint64 start = 0;
+        WeatherSketch sketch;
+    };
+
+    static const int ColumnCount = 3;
+    static const WeatherStore::Column columns[ColumnCount];
+    static bool isSketched(WeatherStore::Column column);
+
+    // Ingest side: accumulate inserted rows, then merge them into the stored sketches inside the open transaction
+    void add(const WeatherRecord &record);
+    bool save(const QSqlDatabase &db);
+
+    static QVector<Bucket> series(const QSqlDatabase &db, WeatherRollups::Level level, WeatherStore::Column column, qint64 from, qint64 to);
+    // Whole days in [from, to), merged from the buckets WeatherRollups::cover picks
+    static WeatherSketch aggregate(const QSqlDatabase &db, WeatherStore::Column column, qint64 from, qint64 to);
+
+    static QString tableName(WeatherRollups::Level level);
+    static QStringList createStatements();
+    // Fills the tables from the rows already in weather
+    static bool backfill(const QSqlDatabase &db);
+
+private:
+    QHash<qint64, WeatherSketch> pending[WeatherRollups::LevelCount][ColumnCount];
+};
+
+#endif // WEATHERSKETCHES_H
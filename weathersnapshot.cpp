@@ -0,0 +1,165 @@
+#include "weathersnapshot.h"
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <cstring>
+
+namespace {
+const char magic[8] = { 'W', 'T', 'H', 'R', 'S', 'N', 'A', 'P' };
+const quint32 formatVersion = 1;
+const qint64 alignment = 64;
+
+struct ColumnHeader
+{
+    qint64 count;
+    double sum;
+    double minimum;
+    double maximum;
+    quint64 offset;
+};
+
+// Arrays follow the header, each starting on a cache-line boundary
+struct Header
+{
+    char magic[8];
+    quint32 version;
+    quint32 columnCount;
+    qint64 generation;
+    qint64 rows;
+    qint64 statisticsRows;
+    quint64 dayOffset;
+    ColumnHeader columns[WeatherStore::ColumnCount];
+};
+
+qint64 aligned(qint64 offset)
+{
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+bool writeAt(QSaveFile &file, qint64 offset, const void *data, qint64 size)
+{
+    static const char padding[alignment] = {};
+    while (file.pos() < offset) {
+        if (file.write(padding, qMin(offset - file.pos(), alignment)) < 0)
+            return false;
+    }
+    return size == 0 || file.write(static_cast<const char *>(data), size) == size;
+}
+}
+
+bool WeatherSnapshot::save(const QString &path, qint64 generation, const WeatherStore &store, const WeatherStatistics &statistics)
+{
+    const qint64 rows = store.size();
+
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = formatVersion;
+    header.columnCount = WeatherStore::ColumnCount;
+    header.generation = generation;
+    header.rows = rows;
+    header.statisticsRows = statistics.rowCount();
+
+    qint64 offset = aligned(sizeof(Header));
+    header.dayOffset = offset;
+    offset = aligned(offset + rows * qint64(sizeof(qint32)));
+    for (int column = 0; column < WeatherStore::ColumnCount; ++column) {
+        const WeatherStatistics::ColumnStatistics &source = statistics.column(static_cast<WeatherStore::Column>(column));
+        ColumnHeader &target = header.columns[column];
+        target.count = source.count;
+        target.sum = source.sum;
+        target.minimum = source.minimum;
+        target.maximum = source.maximum;
+        target.offset = offset;
+        offset = aligned(offset + rows * qint64(sizeof(float)));
+    }
+
+    // QSaveFile only replaces the old snapshot once the new one is complete
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Cannot write snapshot:" << path << file.errorString();
+        return false;
+    }
+
+    bool ok = writeAt(file, 0, &header, sizeof(header))
+              && writeAt(file, header.dayOffset, store.days(), rows * qint64(sizeof(qint32)));
+    for (int column = 0; ok && column < WeatherStore::ColumnCount; ++column)
+        ok = writeAt(file, header.columns[column].offset, store.column(static_cast<WeatherStore::Column>(column)),
+                     rows * qint64(sizeof(float)));
+
+    if (!ok || !file.commit()) {
+        qWarning() << "Cannot write snapshot:" << path << file.errorString();
+        file.cancelWriting();
+        return false;
+    }
+    return true;
+}
+
+bool WeatherSnapshot::load(const QString &path, qint64 generation, WeatherStore &store, WeatherStatistics &statistics)
+{
+    QFile file(path);
+    if (generation < 0 || !file.open(QIODevice::ReadOnly) || file.size() < qint64(sizeof(Header)))
+        return false;
+
+    const uchar *data = file.map(0, file.size());
+    if (!data)
+        return false;
+
+    Header header;
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, magic, sizeof(magic)) != 0 || header.version != formatVersion
+        || header.columnCount != WeatherStore::ColumnCount || header.generation != generation || header.rows < 0
+        || header.rows > file.size())
+        return false;
+
+    const quint64 size = file.size();
+    auto fits = [&](quint64 offset, quint64 bytes) {
+        return offset % alignment == 0 && offset <= size && bytes <= size - offset;
+    };
+
+    const quint64 rows = header.rows;
+    if (!fits(header.dayOffset, rows * sizeof(qint32)))
+        return false;
+
+    const float *columns[WeatherStore::ColumnCount];
+    for (int column = 0; column < WeatherStore::ColumnCount; ++column) {
+        if (!fits(header.columns[column].offset, rows * sizeof(float)))
+            return false;
+        columns[column] = reinterpret_cast<const float *>(data + header.columns[column].offset);
+    }
+
+    store.assign(reinterpret_cast<const qint32 *>(data + header.dayOffset), columns, header.rows);
+
+    statistics.reset();
+    statistics.setRowCount(header.statisticsRows);
+    for (int column = 0; column < WeatherStore::ColumnCount; ++column) {
+        WeatherStatistics::ColumnStatistics columnStatistics;
+        columnStatistics.count = header.columns[column].count;
+        columnStatistics.sum = header.columns[column].sum;
+        columnStatistics.minimum = header.columns[column].minimum;
+        columnStatistics.maximum = header.columns[column].maximum;
+        statistics.setColumn(static_cast<WeatherStore::Column>(column), columnStatistics);
+    }
+
+    return true;
+}
+
+QString WeatherSnapshot::pathFor(const QString &databasePath)
+{
+    const QFileInfo info(databasePath);
+    return info.absoluteDir().filePath(info.completeBaseName() + ".snapshot");
+}
+
+qint64 WeatherSnapshot::generation(const QSqlDatabase &db)
+{
+    QSqlQuery query(db);
+    if (!query.exec("SELECT value FROM weather_meta WHERE name = 'generation'") || !query.next()) {
+        qDebug() << "Error reading database generation:" << query.lastError().text();
+        return -1;
+    }
+    return query.value(0).toLongLong();
+}
@@ -0,0 +1,20 @@
+#ifndef WEATHERSNAPSHOT_H
+#define WEATHERSNAPSHOT_H
+
+#include "weatherstatistics.h"
+#include "weatherstore.h"
+#include <QString>
+
+// Binary copy of the column store and statistics, tagged with the database generation it was taken at.
+class WeatherSnapshot
+{
+public:
+    static bool save(const QString &path, qint64 generation, const WeatherStore &store, const WeatherStatistics &statistics);
+    // Fails without touching the outputs when the file is missing, corrupt or from another generation
+    static bool load(const QString &path, qint64 generation, WeatherStore &store, WeatherStatistics &statistics);
+
+    static QString pathFor(const QString &databasePath);
+    static qint64 generation(const QSqlDatabase &db);
+};
+
+#endif // WEATHERSNAPSHOT_H
@@ -0,0 +1,177 @@
+#include "weatherstatistics.h"
+#include <QDebug>
+#include <QSqlError>
+#include <QSqlQuery>
+
+namespace {
+const QString rowsKey = "rows";
+}
+
+double WeatherStatistics::ColumnStatistics::mean() const
+{
+    return count > 0 ? sum / count : 0.0;
+}
+
+WeatherStatistics::WeatherStatistics()
+    : rows(0)
+{
+}
+
+void WeatherStatistics::reset()
+{
+    rows = 0;
+    for (ColumnStatistics &statistics : columns)
+        statistics = ColumnStatistics();
+}
+
+void WeatherStatistics::add(const WeatherRecord &record)
+{
+    ++rows;
+    for (int field = 0; field < WeatherRecord::FieldCount; ++field) {
+        if (!record.isMissing(static_cast<WeatherRecord::Field>(field)))
+            add(static_cast<WeatherStore::Column>(field), record.value(static_cast<WeatherRecord::Field>(field)));
+    }
+}
+
+void WeatherStatistics::merge(const WeatherStatistics &other)
+{
+    rows += other.rows;
+    for (int column = 0; column < WeatherStore::ColumnCount; ++column) {
+        const ColumnStatistics &source = other.columns[column];
+        ColumnStatistics &target = columns[column];
+        if (source.count == 0)
+            continue;
+        if (target.count == 0) {
+            target.minimum = source.minimum;
+            target.maximum = source.maximum;
+        } else {
+            target.minimum = qMin(target.minimum, source.minimum);
+            target.maximum = qMax(target.maximum, source.maximum);
+        }
+        target.count += source.count;
+        target.sum += source.sum;
+    }
+}
+
+void WeatherStatistics::add(WeatherStore::Column column, double value)
+{
+    ColumnStatistics &statistics = columns[column];
+    if (statistics.count == 0) {
+        statistics.minimum = statistics.maximum = value;
+    } else {
+        statistics.minimum = qMin(statistics.minimum, value);
+        statistics.maximum = qMax(statistics.maximum, value);
+    }
+    ++statistics.count;
+    statistics.sum += value;
+}
+
+qint64 WeatherStatistics::rowCount() const
+{
+    return rows;
+}
+
+void WeatherStatistics::setRowCount(qint64 count)
+{
+    rows = count;
+}
+
+const WeatherStatistics::ColumnStatistics &WeatherStatistics::column(WeatherStore::Column column) const
+{
+    return columns[column];
+}
+
+void WeatherStatistics::setColumn(WeatherStore::Column column, const ColumnStatistics &statistics)
+{
+    columns[column] = statistics;
+}
+
+bool WeatherStatistics::load(const QSqlDatabase &db)
+{
+    reset();
+
+    QSqlQuery query(db);
+    if (!query.exec("SELECT name, count, sum, minimum, maximum FROM weather_statistics")) {
+        qDebug() << "Error loading statistics:" << query.lastError().text();
+        return false;
+    }
+
+    bool complete = false;
+    while (query.next()) {
+        const QString name = query.value(0).toString();
+        if (name == rowsKey) {
+            rows = query.value(1).toLongLong();
+            complete = true;
+            continue;
+        }
+
+        for (int column = 0; column < WeatherStore::ColumnCount; ++column) {
+            if (WeatherStore::columnName(static_cast<WeatherStore::Column>(column)) == name) {
+                columns[column].count = query.value(1).toLongLong();
+                columns[column].sum = query.value(2).toDouble();
+                columns[column].minimum = query.value(3).toDouble();
+                columns[column].maximum = query.value(4).toDouble();
+            }
+        }
+    }
+
+    // Databases from before the statistics table have no row count until a writer rebuilds them
+    return complete;
+}
+
+bool WeatherStatistics::save(const QSqlDatabase &db) const
+{
+    QSqlQuery query(db);
+    query.prepare("INSERT OR REPLACE INTO weather_statistics (name, count, sum, minimum, maximum) VALUES (?, ?, ?, ?, ?)");
+
+    query.bindValue(0, rowsKey);
+    query.bindValue(1, rows);
+    query.bindValue(2, QVariant());
+    query.bindValue(3, QVariant());
+    query.bindValue(4, QVariant());
+    if (!query.exec()) {
+        qDebug() << "Error saving statistics:" << query.lastError().text();
+        return false;
+    }
+
+    for (int column = 0; column < WeatherStore::ColumnCount; ++column) {
+        const ColumnStatistics &statistics = columns[column];
+        query.bindValue(0, WeatherStore::columnName(static_cast<WeatherStore::Column>(column)));
+        query.bindValue(1, statistics.count);
+        query.bindValue(2, statistics.sum);
+        query.bindValue(3, statistics.minimum);
+        query.bindValue(4, statistics.maximum);
+        if (!query.exec()) {
+            qDebug() << "Error saving statistics:" << query.lastError().text();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool WeatherStatistics::rebuild(const QSqlDatabase &db)
+{
+    QStringList aggregates = { "COUNT(*)" };
+    for (int column = 0; column < WeatherStore::ColumnCount; ++column) {
+        const QString name = WeatherStore::columnName(static_cast<WeatherStore::Column>(column));
+        aggregates << QString("COUNT(%1), TOTAL(%1), MIN(%1), MAX(%1)").arg(name);
+    }
+
+    QSqlQuery query(db);
+    if (!query.exec("SELECT " + aggregates.join(", ") + " FROM weather") || !query.next()) {
+        qDebug() << "Error rebuilding statistics:" << query.lastError().text();
+        return false;
+    }
+
+    rows = query.value(0).toLongLong();
+    for (int column = 0; column < WeatherStore::ColumnCount; ++column) {
+        const int field = 1 + column * 4;
+        columns[column].count = query.value(field).toLongLong();
+        columns[column].sum = query.value(field + 1).toDouble();
+        columns[column].minimum = query.value(field + 2).toDouble();
+        columns[column].maximum = query.value(field + 3).toDouble();
+    }
+
+    return save(db);
+}
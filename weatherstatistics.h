@@ -0,0 +1,44 @@
+#ifndef WEATHERSTATISTICS_H
+#define WEATHERSTATISTICS_H
+
+#include "weatherrecord.h"
+#include "weatherstore.h"
+#include <QSqlDatabase>
+
+// Running count/sum/min/max per column, persisted in the weather_statistics table.
+class WeatherStatistics
+{
+public:
+    struct ColumnStatistics
+    {
+        qint64 count = 0;
+        double sum = 0.0;
+        double minimum = 0.0;
+        double maximum = 0.0;
+        double mean() const;
+    };
+
+    WeatherStatistics();
+    void reset();
+    void add(const WeatherRecord &record);
+    void merge(const WeatherStatistics &other);
+
+    qint64 rowCount() const;
+    void setRowCount(qint64 count);
+    const ColumnStatistics &column(WeatherStore::Column column) const;
+    void setColumn(WeatherStore::Column column, const ColumnStatistics &statistics);
+
+    // Read only, false if the table is incomplete
+    bool load(const QSqlDatabase &db);
+    bool save(const QSqlDatabase &db) const;
+    // One aggregate pass over weather, then save; writers only, under the database's WeatherDatabase::writeLock()
+    bool rebuild(const QSqlDatabase &db);
+
+private:
+    void add(WeatherStore::Column column, double value);
+
+    qint64 rows;
+    ColumnStatistics columns[WeatherStore::ColumnCount];
+};
+
+#endif // WEATHERSTATISTICS_H
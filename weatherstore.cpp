@@ -0,0 +1,213 @@
+#include "weatherstore.h"
+#include <QDebug>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+double WeatherStore::Aggregate::mean() const
+{
+    return count > 0 ? sum / count : 0.0;
+}
+
+WeatherStore::WeatherStore()
+{
+}
+
+bool WeatherStore::load(const QSqlDatabase &db)
+{
+    clear();
+
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    if (!query.exec(R"(
+        SELECT time, averageTemperature, minimumTemperature, maximunTemperature,
+               precipitation, snow, windDirection, windSpeed, windPeakGust,
+               airPressure, sunshineDuration
+        FROM weather ORDER BY time
+    )")) {
+        qDebug() << "Error loading weather store:" << query.lastError().text();
+        return false;
+    }
+
+    while (query.next()) {
+        dayColumn.append(WeatherRecord::dayOf(query.value(0).toLongLong()));
+        // Missing measurements are kept as NaN and skipped by the aggregates
+        for (int column = 0; column < ColumnCount; ++column) {
+            const QVariant value = query.value(column + 1);
+            columns[column].append(value.isNull() ? std::numeric_limits<float>::quiet_NaN() : value.toFloat());
+        }
+    }
+
+    return true;
+}
+
+void WeatherStore::assign(const qint32 *days, const float *const *columns, qsizetype rows)
+{
+    dayColumn = QVector<qint32>(days, days + rows);
+    for (int column = 0; column < ColumnCount; ++column)
+        this->columns[column] = QVector<float>(columns[column], columns[column] + rows);
+}
+
+void WeatherStore::append(const WeatherRecord &record)
+{
+    dayColumn.append(record.epochDay());
+    for (int column = 0; column < ColumnCount; ++column)
+        columns[column].append(static_cast<float>(record.value(static_cast<WeatherRecord::Field>(column))));
+}
+
+void WeatherStore::clear()
+{
+    dayColumn.clear();
+    for (QVector<float> &column : columns)
+        column.clear();
+}
+
+qsizetype WeatherStore::size() const
+{
+    return dayColumn.size();
+}
+
+bool WeatherStore::isEmpty() const
+{
+    return dayColumn.isEmpty();
+}
+
+qint32 WeatherStore::day(qsizetype row) const
+{
+    return dayColumn.at(row);
+}
+
+float WeatherStore::value(Column column, qsizetype row) const
+{
+    return columns[column].at(row);
+}
+
+const qint32 *WeatherStore::days() const
+{
+    return dayColumn.constData();
+}
+
+const float *WeatherStore::column(Column column) const
+{
+    return columns[column].constData();
+}
+
+QVector<qint32> WeatherStore::dayData() const
+{
+    return dayColumn;
+}
+
+QVector<float> WeatherStore::columnData(Column column) const
+{
+    return columns[column];
+}
+
+QPair<qsizetype, qsizetype> WeatherStore::rowRange(qint32 fromDay, qint32 toDay) const
+{
+    const qint32 *begin = dayColumn.constData();
+    const qint32 *end = begin + dayColumn.size();
+    const qint32 *first = std::lower_bound(begin, end, fromDay);
+    const qint32 *last = std::upper_bound(first, end, toDay);
+    return qMakePair<qsizetype, qsizetype>(first - begin, last - begin);
+}
+
+WeatherStore::Aggregate WeatherStore::aggregate(Column column) const
+{
+    return aggregate(column, 0, size());
+}
+
+WeatherStore::Aggregate WeatherStore::aggregate(Column column, qint32 fromDay, qint32 toDay) const
+{
+    const QPair<qsizetype, qsizetype> range = rowRange(fromDay, toDay);
+    return aggregate(column, range.first, range.second);
+}
+
+WeatherStore::Aggregate WeatherStore::aggregate(Column column, qsizetype first, qsizetype last) const
+{
+    Aggregate result;
+    first = qMax<qsizetype>(first, 0);
+    last = qMin(last, size());
+    if (first >= last)
+        return result;
+
+    const float *data = columns[column].constData() + first;
+    const qsizetype count = last - first;
+
+    // Independent lanes keep the hot loop free of loop-carried dependencies so it vectorizes.
+    // NaN compares false everywhere, so missing values drop out of min/max without a branch.
+    constexpr int lanes = 8;
+    const float infinity = std::numeric_limits<float>::infinity();
+    float lowest[lanes];
+    float highest[lanes];
+    double sum[lanes];
+    qsizetype present[lanes];
+    for (int lane = 0; lane < lanes; ++lane) {
+        lowest[lane] = infinity;
+        highest[lane] = -infinity;
+        sum[lane] = 0.0;
+        present[lane] = 0;
+    }
+
+    qsizetype i = 0;
+    for (; i + lanes <= count; i += lanes) {
+        for (int lane = 0; lane < lanes; ++lane) {
+            const float value = data[i + lane];
+            const bool valid = value == value;
+            lowest[lane] = value < lowest[lane] ? value : lowest[lane];
+            highest[lane] = value > highest[lane] ? value : highest[lane];
+            sum[lane] += valid ? value : 0.0;
+            present[lane] += valid;
+        }
+    }
+    for (; i < count; ++i) {
+        const float value = data[i];
+        if (value != value)
+            continue;
+        lowest[0] = value < lowest[0] ? value : lowest[0];
+        highest[0] = value > highest[0] ? value : highest[0];
+        sum[0] += value;
+        ++present[0];
+    }
+
+    result.count = std::accumulate(present, present + lanes, qsizetype(0));
+    if (result.count == 0)
+        return result;
+    result.min = *std::min_element(lowest, lowest + lanes);
+    result.max = *std::max_element(highest, highest + lanes);
+    result.sum = std::accumulate(sum, sum + lanes, 0.0);
+    return result;
+}
+
+QString WeatherStore::columnName(Column column)
+{
+    switch (column) {
+    case AverageTemperature: return "averageTemperature";
+    case MinimumTemperature: return "minimumTemperature";
+    case MaximunTemperature: return "maximunTemperature";
+    case Precipitation: return "precipitation";
+    case Snow: return "snow";
+    case WindDirection: return "windDirection";
+    case WindSpeed: return "windSpeed";
+    case WindPeakGust: return "windPeakGust";
+    case AirPressure: return "airPressure";
+    case SunshineDuration: return "sunshineDuration";
+    default: return QString();
+    }
+}
+
+qint32 WeatherStore::toEpochDay(const QDate &date)
+{
+    return static_cast<qint32>(date.toJulianDay() - QDate(1970, 1, 1).toJulianDay());
+}
+
+QDate WeatherStore::fromEpochDay(qint32 day)
+{
+    return QDate(1970, 1, 1).addDays(day);
+}
+
+qint64 WeatherStore::toMSecsSinceEpoch(qint32 day)
+{
+    return fromEpochDay(day).startOfDay().toMSecsSinceEpoch();
+}
@@ -0,0 +1,67 @@
+#ifndef WEATHERSTORE_H
+#define WEATHERSTORE_H
+
+#include "weatherrecord.h"
+#include <QDate>
+#include <QPair>
+#include <QSqlDatabase>
+#include <QVector>
+
+// Column-oriented copy of the weather table, rows ordered by date.
+class WeatherStore
+{
+public:
+    enum Column {
+        AverageTemperature,
+        MinimumTemperature,
+        MaximunTemperature,
+        Precipitation,
+        Snow,
+        WindDirection,
+        WindSpeed,
+        WindPeakGust,
+        AirPressure,
+        SunshineDuration,
+        ColumnCount
+    };
+
+    struct Aggregate
+    {
+        qsizetype count = 0;
+        double sum = 0.0;
+        float min = 0.0f;
+        float max = 0.0f;
+        double mean() const;
+    };
+
+    WeatherStore();
+    bool load(const QSqlDatabase &db);
+    void assign(const qint32 *days, const float *const *columns, qsizetype rows);
+    void append(const WeatherRecord &record);
+    void clear();
+
+    qsizetype size() const;
+    bool isEmpty() const;
+    qint32 day(qsizetype row) const;
+    float value(Column column, qsizetype row) const;
+    const qint32 *days() const;
+    const float *column(Column column) const;
+    QVector<qint32> dayData() const;
+    QVector<float> columnData(Column column) const;
+
+    QPair<qsizetype, qsizetype> rowRange(qint32 fromDay, qint32 toDay) const;
+    Aggregate aggregate(Column column) const;
+    Aggregate aggregate(Column column, qint32 fromDay, qint32 toDay) const;
+    Aggregate aggregate(Column column, qsizetype first, qsizetype last) const;
+
+    static QString columnName(Column column);
+    static qint32 toEpochDay(const QDate &date);
+    static QDate fromEpochDay(qint32 day);
+    static qint64 toMSecsSinceEpoch(qint32 day);
+
+private:
+    QVector<qint32> dayColumn;
+    QVector<float> columns[ColumnCount];
+};
+
+#endif // WEATHERSTORE_H
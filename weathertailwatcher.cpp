@@ -0,0 +1,100 @@
+#include "weathertailwatcher.h"
+#include "weatheringestor.h"
+#include <QtConcurrent/QtConcurrent>
+
+namespace {
+// Writers touch a file several times per append, collect them into one ingest
+const int batchInterval = 500;
+}
+
+WeatherTailWatcher::WeatherTailWatcher(const QString &databasePath, QObject *parent)
+    : QObject(parent)
+    , databasePath(databasePath)
+    , pending(false)
+{
+    batchTimer.setSingleShot(true);
+    batchTimer.setInterval(batchInterval);
+
+    connect(&watcher, &QFileSystemWatcher::directoryChanged, this, &WeatherTailWatcher::directoryChanged);
+    connect(&watcher, &QFileSystemWatcher::fileChanged, &batchTimer, qOverload<>(&QTimer::start));
+    connect(&batchTimer, &QTimer::timeout, this, &WeatherTailWatcher::ingest);
+    connect(&ingestWatcher, &QFutureWatcher<QVector<WeatherRecord>>::finished, this, &WeatherTailWatcher::ingestFinished);
+}
+
+void WeatherTailWatcher::watch(const QString &directoryPath)
+{
+    stop();
+    directory = directoryPath;
+    watcher.addPath(directory);
+    watchFiles();
+
+    // Catch up on whatever was appended while nobody was watching
+    batchTimer.start();
+}
+
+void WeatherTailWatcher::stop()
+{
+    batchTimer.stop();
+    pending = false;
+    if (!watcher.files().isEmpty())
+        watcher.removePaths(watcher.files());
+    if (!watcher.directories().isEmpty())
+        watcher.removePaths(watcher.directories());
+    directory.clear();
+}
+
+bool WeatherTailWatcher::isWatching() const
+{
+    return !directory.isEmpty();
+}
+
+void WeatherTailWatcher::directoryChanged()
+{
+    watchFiles();
+    batchTimer.start();
+}
+
+// Files replaced by rename drop out of the watcher, so the list is re-added on every directory change
+void WeatherTailWatcher::watchFiles()
+{
+    const QStringList files = WeatherIngestor::csvFiles(directory);
+    const QStringList watched = watcher.files();
+    for (const QString &file : files) {
+        if (!watched.contains(file))
+            watcher.addPath(file);
+    }
+}
+
+void WeatherTailWatcher::ingest()
+{
+    if (!isWatching())
+        return;
+
+    if (ingestWatcher.isRunning()) {
+        pending = true;
+        return;
+    }
+
+    // The manifest limits each pass to the bytes appended since the last one
+    const QString database = databasePath;
+    const QStringList files = WeatherIngestor::csvFiles(directory);
+    ingestWatcher.setFuture(QtConcurrent::run([database, files]() {
+        WeatherIngestor ingestor(database);
+        ingestor.setCollectInserted(true);
+        ingestor.setTailing(true);
+        ingestor.ingest(files);
+        return ingestor.takeInserted();
+    }));
+}
+
+void WeatherTailWatcher::ingestFinished()
+{
+    const QVector<WeatherRecord> records = ingestWatcher.result();
+    if (!records.isEmpty() && isWatching())
+        emit recordsAppended(records);
+
+    if (pending) {
+        pending = false;
+        ingest();
+    }
+}
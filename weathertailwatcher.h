@@ -0,0 +1,41 @@
+#ifndef WEATHERTAILWATCHER_H
+#define WEATHERTAILWATCHER_H
+
+#include "weatherrecord.h"
+#include <QFileSystemWatcher>
+#include <QFutureWatcher>
+#include <QObject>
+#include <QTimer>
+
+// Watches a data directory and ingests appended CSV lines in small batches.
+class WeatherTailWatcher : public QObject
+{
+    Q_OBJECT
+public:
+    explicit WeatherTailWatcher(const QString &databasePath, QObject *parent = nullptr);
+
+    void watch(const QString &directoryPath);
+    void stop();
+    bool isWatching() const;
+
+signals:
+    // Only rows that were new to the database, in no particular order
+    void recordsAppended(const QVector<WeatherRecord> &records);
+
+private slots:
+    void directoryChanged();
+    void ingest();
+    void ingestFinished();
+
+private:
+    void watchFiles();
+
+    QString databasePath;
+    QString directory;
+    QFileSystemWatcher watcher;
+    QTimer batchTimer;
+    QFutureWatcher<QVector<WeatherRecord>> ingestWatcher;
+    bool pending;
+};
+
+#endif // WEATHERTAILWATCHER_H
@@ -1,131 +1,41 @@
 #include "weatherutil.h"
+#include "weatherdatabase.h"
+#include "weatheringestor.h"
+#include "weathersnapshot.h"
 #include <QDir>
+#include <QElapsedTimer>
 #include <QSqlDatabase>
 #include <QSqlQuery>
 #include <QSqlError>
-#include <QtCharts/QChartView>
-#include <QtCharts/QLineSeries>
-#include <QtCharts/QValueAxis>
-#include <QtCharts/QDateTimeAxis>
-#include <QFuture>
-#include <QMutex>
 #include <QSqlRecord>
 #include <QtConcurrent/QtConcurrent>
 
 WeatherUtil::WeatherUtil(QObject *parent)
-    : QObject{parent}
+    : WeatherUtil("weather.db", parent)
 {
-    db = QSqlDatabase::addDatabase("QSQLITE");
-    db.setDatabaseName("weather.db");
-
-    if (!db.open()) {
-        qDebug() << "Error: Unable to connect to database!" << db.lastError().text();
-    }
 }
 
-void processCsvFile(const QString &filePath, const QString &dbPath, QMutex *mutex)
+WeatherUtil::WeatherUtil(const QString &databasePath, QObject *parent)
+    : QObject{parent}
 {
-    QString connectionName = QUuid::createUuid().toString();
-    QSqlDatabase threadDb = QSqlDatabase::addDatabase("QSQLITE", connectionName);
-    threadDb.setDatabaseName(dbPath);
-
-    if (!threadDb.open()) {
-        qWarning() << "Thread DB open failed:" << threadDb.lastError().text();
-        return;
-    }
-
-    QFile file(filePath);
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        qWarning() << "Cannot open file:" << filePath;
-        return;
-    }
-
-    QTextStream in(&file);
-    bool firstLine = true;
-    while (!in.atEnd()) {
-        QString line = in.readLine();
-        if (firstLine) {
-            firstLine = false;
-            continue;
-        }
-
-        try {
-            Weather element;
-            element.parse(line);
-
-            QSqlQuery query(threadDb);
-
-            // Lock while checking and inserting
-            QMutexLocker locker(mutex);
-            query.prepare("SELECT COUNT(*) FROM weather WHERE date = :date");
-            query.bindValue(":date", element.getDate().toString(Qt::ISODate));
-            if (query.exec() && query.next() && query.value(0).toInt() == 0) {
-                query.prepare(R"(
-                    INSERT INTO weather (
-                        date, averageTemperature, minimumTemperature, maximunTemperature,
-                        precipitation, snow, windDirection, windSpeed, windPeakGust,
-                        airPressure, sunshineDuration
-                    ) VALUES (
-                        :date, :averageTemperature, :minimumTemperature, :maximunTemperature,
-                        :precipitation, :snow, :windDirection, :windSpeed, :windPeakGust,
-                        :airPressure, :sunshineDuration
-                    )
-                )");
-
-                query.bindValue(":date", element.getDate().toString(Qt::ISODate));
-                query.bindValue(":averageTemperature", element.getAverageTemperature());
-                query.bindValue(":minimumTemperature", element.getMinimumTemperature());
-                query.bindValue(":maximunTemperature", element.getMaximunTemperature());
-                query.bindValue(":precipitation", element.getPrecipitation());
-                query.bindValue(":snow", element.getSnow());
-                query.bindValue(":windDirection", element.getWindDirection());
-                query.bindValue(":windSpeed", element.getWindSpeed());
-                query.bindValue(":windPeakGust", element.getWindPeakGust());
-                query.bindValue(":airPressure", element.getAirPressure());
-                query.bindValue(":sunshineDuration", element.getSunshineDuration());
-
-                if (!query.exec()) {
-                    qWarning() << "Insert failed:" << query.lastError().text();
-                }
-            }
-        } catch (...) {
-            qWarning() << "Error parsing line in file:" << filePath;
-        }
-    }
+    db = WeatherDatabase::connection(databasePath);
+    if (db.isOpen())
+        statistics.load(db);
+}
 
-    file.close();
-    threadDb.close();
-    QSqlDatabase::removeDatabase(connectionName);
+QSqlDatabase WeatherUtil::database() const
+{
+    return db;
 }
 
 bool WeatherUtil::loadFromDirectory(const QString &directoryPath)
 {
-    QDir dir(directoryPath);
-    if (!dir.exists()) {
-        qWarning() << "Directory does not exist:" << directoryPath;
+    const QStringList csvFiles = WeatherIngestor::csvFiles(directoryPath);
+    if (csvFiles.isEmpty())
         return false;
-    }
-
-    const QStringList csvFiles = dir.entryList(QStringList() << "*.csv", QDir::Files);
-    if (csvFiles.isEmpty()) {
-        qWarning() << "No CSV files found in:" << directoryPath;
-        return false;
-    }
-
-    QMutex *mutex = new QMutex();
-    QList<QFuture<void>> futures;
-
-    for (const QString &fileName : csvFiles) {
-        QString fullPath = dir.filePath(fileName);
-        QFuture<void> future = QtConcurrent::run(processCsvFile, fullPath, db.databaseName(), mutex);
-        futures.append(future);
-    }
 
-    for (auto &future : futures) {
-        future.waitForFinished();
-    }
-
-    delete mutex;
+    WeatherIngestor ingestor(db.databaseName());
+    ingestor.ingest(csvFiles);
     return true;
 }
 
@@ -133,7 +43,7 @@ QVector<Weather> WeatherUtil::select(const QString &selectQuery)
 {
     QVector<Weather> weatherList;
 
-    QSqlQuery query;
+    QSqlQuery query(db);
     if (!query.exec(selectQuery)) {
         qDebug() << "Error executing select query:" << query.lastError().text();
         return weatherList;
@@ -148,171 +58,192 @@ QVector<Weather> WeatherUtil::select(const QString &selectQuery)
     return weatherList;
 }
 
-QVector<QMap<QString, QVariant>> WeatherUtil::selectAsMap(const QString &selectQuery)
+QueryResult WeatherUtil::selectResult(const QString &selectQuery)
 {
-    QVector<QMap<QString, QVariant>> resultList;
-
-    QSqlQuery query;
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
     if (!query.exec(selectQuery)) {
         qDebug() << "Error executing select query:" << query.lastError().text();
-        return resultList;
+        return QueryResult();
     }
 
-    while (query.next()) {
-        QMap<QString, QVariant> rowMap;
-        for (int i = 0; i < query.record().count(); ++i) {
-            QString columnName = query.record().fieldName(i);
-            QVariant value = query.value(i);
-            rowMap.insert(columnName, value);
-        }
-        resultList.append(rowMap);
-    }
+    QueryResult result(query.record());
+    while (query.next())
+        result.appendRow(query);
 
-    return resultList;
+    return result;
 }
 
-double WeatherUtil::highestTemp()
+QueryResult WeatherUtil::run(const WeatherQuery &query)
 {
-    QVector<Weather> m_entries = select("SELECT * FROM weather");
-    if (m_entries.isEmpty())
-        return 0.0f;
-
-    float highest = m_entries.first().getMaximunTemperature();
-
-    for (const Weather &weather : std::as_const(m_entries)) {
-        if (weather.getMaximunTemperature() > highest) {
-            highest = weather.getMaximunTemperature();
+    // Statements are keyed by their SQL, which carries no values, so each query shape is prepared once
+    const QString sql = query.sql();
+    auto prepared = preparedQueries.find(sql);
+    if (prepared == preparedQueries.end()) {
+        QSqlQuery statement(db);
+        statement.setForwardOnly(true);
+        if (!statement.prepare(sql)) {
+            qDebug() << "Error preparing weather query:" << statement.lastError().text() << sql;
+            return QueryResult();
         }
+        prepared = preparedQueries.insert(sql, statement);
     }
-    return highest;
+    return query.run(prepared.value());
 }
 
-double WeatherUtil::avgTemp()
+bool WeatherUtil::reloadStore()
 {
-    QVector<Weather> m_entries = select("SELECT * FROM weather");
+    QElapsedTimer timer;
+    timer.start();
+
+    // Cached windows point at rows of the old store
+    windows.clear();
+
+    // A snapshot from the current generation holds exactly what the table scan would return
+    const QString snapshotPath = WeatherSnapshot::pathFor(db.databaseName());
+    const qint64 generation = WeatherSnapshot::generation(db);
+    if (WeatherSnapshot::load(snapshotPath, generation, store, statistics)) {
+        qDebug() << "Loaded" << store.size() << "rows from snapshot in" << timer.elapsed() << "ms";
+        return true;
+    }
 
-    if (m_entries.isEmpty())
-        return 0.0f;
+    if (!store.load(db))
+        return false;
+    qDebug() << "Loaded" << store.size() << "rows from database in" << timer.elapsed() << "ms";
 
-    float sum = 0.0f;
-    for (const Weather &weather : std::as_const(m_entries)) {
-        sum += weather.getAverageTemperature();
-    }
-    return sum / m_entries.size();
+    if (generation >= 0)
+        WeatherSnapshot::save(snapshotPath, generation, store, statistics);
+    return true;
 }
 
-double WeatherUtil::lowestTemp()
+// Extends the store with freshly ingested rows sorted by date, or reloads it if they land before its end
+bool WeatherUtil::appendRecords(const QVector<WeatherRecord> &records)
 {
-    QVector<Weather> m_entries = select("SELECT * FROM weather");
-
-    if (m_entries.isEmpty())
-        return 0.0f;
+    statistics.load(db);
+    if (records.isEmpty())
+        return true;
 
-    float lowest = m_entries.first().getMinimumTemperature();
-
-    for (const Weather &weather : std::as_const(m_entries)) {
-        if (weather.getMinimumTemperature() < lowest) {
-            lowest = weather.getMinimumTemperature();
-        }
+    if (!store.isEmpty() && records.first().epochDay() < store.day(store.size() - 1)) {
+        reloadStore();
+        return false;
     }
-    return lowest;
+
+    for (const WeatherRecord &record : records)
+        store.append(record);
+    return true;
 }
 
-QChartView *WeatherUtil::createTemperatureChart()
+const WeatherStore &WeatherUtil::weatherStore() const
 {
-    QVector<Weather> m_entries = select("SELECT * FROM weather");
-
-    if (m_entries.isEmpty())
-        return nullptr;
+    return store;
+}
 
-    QLineSeries *avgTempSeries = new QLineSeries();
-    avgTempSeries->setName("Average Temp");
+const WeatherWindow &WeatherUtil::rollingWindow(WeatherStore::Column column, int days)
+{
+    const QPair<int, int> key(column, days);
+    auto window = windows.find(key);
+    if (window == windows.end())
+        window = windows.insert(key, WeatherWindow(column, days));
+    window->extend(store);
+    return *window;
+}
 
-    QLineSeries *minTempSeries = new QLineSeries();
-    minTempSeries->setName("Minimum Temp");
+bool WeatherUtil::reloadStatistics()
+{
+    return statistics.load(db);
+}
 
-    QLineSeries *maxTempSeries = new QLineSeries();
-    maxTempSeries->setName("Maximum Temp");
+void WeatherUtil::resetStatistics()
+{
+    statistics.reset();
+}
 
-    for (const Weather &weather : std::as_const(m_entries)) {
-        qint64 timestamp = weather.getDate().toMSecsSinceEpoch();
-        avgTempSeries->append(timestamp, weather.getAverageTemperature());
-        minTempSeries->append(timestamp, weather.getMinimumTemperature());
-        maxTempSeries->append(timestamp, weather.getMaximunTemperature());
-    }
+const WeatherStatistics &WeatherUtil::weatherStatistics() const
+{
+    return statistics;
+}
 
-    QChart *chart = new QChart();
-    chart->addSeries(avgTempSeries);
-    chart->addSeries(minTempSeries);
-    chart->addSeries(maxTempSeries);
-    chart->setTitle("Temperature Over Time");
-    chart->legend()->setAlignment(Qt::AlignBottom);
+// Monthly means over decades read a few hundred rollup rows instead of every observation
+QVector<WeatherRollups::Bucket> WeatherUtil::rollupSeries(qint64 from, qint64 to, int maxBuckets)
+{
+    return WeatherRollups::series(db, WeatherRollups::levelFor(from, to, maxBuckets), from, to);
+}
 
-    QDateTimeAxis *axisX = new QDateTimeAxis;
-    axisX->setFormat("yyyy-MM-dd");
-    axisX->setTitleText("Date");
-    chart->addAxis(axisX, Qt::AlignBottom);
+WeatherStatistics WeatherUtil::rollupAggregate(qint64 from, qint64 to)
+{
+    return WeatherRollups::aggregate(db, from, to);
+}
 
-    avgTempSeries->attachAxis(axisX);
-    minTempSeries->attachAxis(axisX);
-    maxTempSeries->attachAxis(axisX);
+WeatherSketch WeatherUtil::sketch(WeatherStore::Column column, qint64 from, qint64 to)
+{
+    return WeatherSketches::aggregate(db, column, from, to);
+}
 
-    QValueAxis *axisY = new QValueAxis;
-    axisY->setTitleText("Temperature (°C)");
-    axisY->setRange(lowestTemp(), highestTemp());
-    chart->addAxis(axisY, Qt::AlignLeft);
+QVector<WeatherSketches::Bucket> WeatherUtil::sketchSeries(WeatherStore::Column column, WeatherRollups::Level level, qint64 from, qint64 to)
+{
+    return WeatherSketches::series(db, level, column, from, to);
+}
 
-    avgTempSeries->attachAxis(axisY);
-    minTempSeries->attachAxis(axisY);
-    maxTempSeries->attachAxis(axisY);
+double WeatherUtil::highestTemp()
+{
+    return statistics.column(WeatherStore::MaximunTemperature).maximum;
+}
 
-    QChartView *chartView = new QChartView(chart);
-    chartView->setRenderHint(QPainter::Antialiasing);
+double WeatherUtil::avgTemp()
+{
+    return statistics.column(WeatherStore::AverageTemperature).mean();
+}
 
-    return chartView;
+double WeatherUtil::lowestTemp()
+{
+    return statistics.column(WeatherStore::MinimumTemperature).minimum;
 }
 
 void WeatherUtil::loadFromDirectoryAsync(const QString &directoryPath)
 {
+    const QString databasePath = db.databaseName();
     QtConcurrent::run([=]() {
-        QDir dir(directoryPath);
-        if (!dir.exists()) {
-            qWarning() << "Directory does not exist:" << directoryPath;
-            emit loadingFinished();  // still emit to unblock any UI loading indicator
-            return;
+        const QStringList csvFiles = WeatherIngestor::csvFiles(directoryPath);
+        if (!csvFiles.isEmpty()) {
+            WeatherIngestor ingestor(databasePath);
+            ingestor.ingest(csvFiles);
         }
 
-        const QStringList csvFiles = dir.entryList(QStringList() << "*.csv", QDir::Files);
-        if (csvFiles.isEmpty()) {
-            qWarning() << "No CSV files found in:" << directoryPath;
-            emit loadingFinished();
-            return;
-        }
-
-        QMutex mutex;
-        QList<QFuture<void>> futures;
-
-        for (const QString &fileName : csvFiles) {
-            QString fullPath = dir.filePath(fileName);
-            QFuture<void> future = QtConcurrent::run(processCsvFile, fullPath, db.databaseName(), &mutex);
-            futures.append(future);
-        }
+        emit loadingFinished();  // still emit to unblock any UI loading indicator
+    });
+}
 
-        for (auto &future : futures) {
-            future.waitForFinished();  // This is okay here since we're already on a background thread
+void WeatherUtil::rebuildFromDirectoryAsync(const QString &directoryPath)
+{
+    const QString databasePath = db.databaseName();
+    QtConcurrent::run([=]() {
+        // An empty directory path clears the database
+        const QStringList csvFiles = directoryPath.isEmpty() ? QStringList() : WeatherIngestor::csvFiles(directoryPath);
+        if (directoryPath.isEmpty() || !csvFiles.isEmpty()) {
+            WeatherIngestor ingestor(databasePath);
+            ingestor.rebuild(csvFiles);
         }
 
         emit loadingFinished();
     });
 }
 
+namespace {
+// Wall-clock seconds, the key the weather table is clustered on
+qint64 timeKey(const QDateTime &date)
+{
+    return WeatherRecord::daysFromCivil(date.date().year(), date.date().month(), date.date().day()) * 86400
+           + date.time().msecsSinceStartOfDay() / 1000;
+}
+}
+
 bool WeatherUtil::insert(const Weather &weather)
 {
-    QSqlQuery query;
+    QSqlQuery query(db);
 
     query.prepare(R"(
         INSERT INTO weather (
-            date,
+            time,
             averageTemperature,
             minimumTemperature,
             maximunTemperature,
@@ -324,7 +255,7 @@ bool WeatherUtil::insert(const Weather &weather)
             airPressure,
             sunshineDuration
         ) VALUES (
-            :date,
+            :time,
             :averageTemperature,
             :minimumTemperature,
             :maximunTemperature,
@@ -339,7 +270,7 @@ bool WeatherUtil::insert(const Weather &weather)
     )");
 
     // Bind values
-    query.bindValue(":date", weather.getDate().toString(Qt::ISODate)); // Save date as ISO format string
+    query.bindValue(":time", timeKey(weather.getDate()));
     query.bindValue(":averageTemperature", weather.getAverageTemperature());
     query.bindValue(":minimumTemperature", weather.getMinimumTemperature());
     query.bindValue(":maximunTemperature", weather.getMaximunTemperature());
@@ -363,11 +294,9 @@ bool WeatherUtil::insert(const Weather &weather)
 }
 
 bool WeatherUtil::checkWeatherExists(const Weather &weather)
-{    
-    for(const Weather &element : select("SELECT * FROM weather")){
-        if (element.getDate() == weather.getDate()) {
-            return true;
-        }
-    }
-    return false;
+{
+    QSqlQuery query(db);
+    query.prepare("SELECT 1 FROM weather WHERE time = ?");
+    query.addBindValue(timeKey(weather.getDate()));
+    return query.exec() && query.next();
 }
@@ -1,28 +1,56 @@
 #ifndef WEATHERUTIL_H
 #define WEATHERUTIL_H
 
+#include "queryresult.h"
 #include "weather.h"
+#include "weatherquery.h"
+#include "weatherrollups.h"
+#include "weathersketches.h"
+#include "weatherstatistics.h"
+#include "weatherstore.h"
+#include "weatherwindow.h"
+#include <QHash>
 #include <QObject>
-#include <qmutex.h>
 #include <qsqldatabase.h>
-#include <QtCharts/QChartView>
 
 class WeatherUtil : public QObject
 {
     Q_OBJECT
 public:
     explicit WeatherUtil(QObject *parent = nullptr);
+    explicit WeatherUtil(const QString &databasePath, QObject *parent = nullptr);
+    QSqlDatabase database() const;
     bool loadFromDirectory(const QString &directoryPath);
     QVector<Weather> select(const QString &selectQuery);
-    QVector<QMap<QString, QVariant>> selectAsMap(const QString &selectQuery);
+    QueryResult selectResult(const QString &selectQuery);
+    // Only the requested columns and rows leave the database
+    QueryResult run(const WeatherQuery &query);
+    bool reloadStore();
+    bool appendRecords(const QVector<WeatherRecord> &records);
+    const WeatherStore &weatherStore() const;
+    // Computed on first use per column and size, then only extended over appended rows
+    const WeatherWindow &rollingWindow(WeatherStore::Column column, int days);
+    bool reloadStatistics();
+    void resetStatistics();
+    const WeatherStatistics &weatherStatistics() const;
+    QVector<WeatherRollups::Bucket> rollupSeries(qint64 from, qint64 to, int maxBuckets);
+    WeatherStatistics rollupAggregate(qint64 from, qint64 to);
+    // Percentiles and histograms from the stored sketches, never from the rows
+    WeatherSketch sketch(WeatherStore::Column column, qint64 from, qint64 to);
+    QVector<WeatherSketches::Bucket> sketchSeries(WeatherStore::Column column, WeatherRollups::Level level, qint64 from, qint64 to);
     double highestTemp();
     double avgTemp();
     double lowestTemp();
-    QChartView* createTemperatureChart();
 public slots:
     void loadFromDirectoryAsync(const QString &directoryPath);
+    // Replaces the contents instead of adding to them, the current data stays readable until one transaction copies the rebuilt rows in
+    void rebuildFromDirectoryAsync(const QString &directoryPath);
 private:
     QSqlDatabase db;
+    WeatherStore store;
+    WeatherStatistics statistics;
+    QHash<QString, QSqlQuery> preparedQueries;
+    QHash<QPair<int, int>, WeatherWindow> windows;
     bool insert(const Weather &weather);
     bool checkWeatherExists(const Weather &weather);
 signals:
@@ -0,0 +1,104 @@
+#include "weatherwindow.h"
+#include <cmath>
+#include <limits>
+
+WeatherWindow::WeatherWindow(WeatherStore::Column column, int days)
+    : valueColumn(column)
+    , windowDays(qMax(1, days))
+{
+    reset();
+}
+
+WeatherStore::Column WeatherWindow::column() const
+{
+    return valueColumn;
+}
+
+int WeatherWindow::days() const
+{
+    return windowDays;
+}
+
+void WeatherWindow::extend(const WeatherStore &store)
+{
+    const qsizetype rows = store.size();
+    if (rows < meanValues.size())
+        reset();
+    if (rows == meanValues.size())
+        return;
+
+    const qint32 *days = store.days();
+    const float *values = store.column(valueColumn);
+    const float missing = std::numeric_limits<float>::quiet_NaN();
+    meanValues.reserve(rows);
+    minimumValues.reserve(rows);
+    maximumValues.reserve(rows);
+
+    // Every row enters and leaves the sum and each deque once, so a pass is linear in the rows whatever the window
+    for (qsizetype row = meanValues.size(); row < rows; ++row) {
+        const float value = values[row];
+        if (!std::isnan(value)) {
+            sum += value;
+            ++count;
+            while (!minimumRows.empty() && values[minimumRows.back()] >= value)
+                minimumRows.pop_back();
+            minimumRows.push_back(row);
+            while (!maximumRows.empty() && values[maximumRows.back()] <= value)
+                maximumRows.pop_back();
+            maximumRows.push_back(row);
+        }
+
+        // A row belongs to the window while its day is one of the last windowDays days
+        const qint32 firstDay = days[row] - windowDays + 1;
+        for (; days[first] < firstDay; ++first) {
+            if (!std::isnan(values[first])) {
+                sum -= values[first];
+                --count;
+            }
+        }
+        while (!minimumRows.empty() && minimumRows.front() < first)
+            minimumRows.pop_front();
+        while (!maximumRows.empty() && maximumRows.front() < first)
+            maximumRows.pop_front();
+
+        // An empty window restarts the sum, so rounding never carries across gaps
+        if (count == 0)
+            sum = 0.0;
+
+        meanValues.append(count > 0 ? float(sum / count) : missing);
+        minimumValues.append(count > 0 ? values[minimumRows.front()] : missing);
+        maximumValues.append(count > 0 ? values[maximumRows.front()] : missing);
+    }
+}
+
+void WeatherWindow::reset()
+{
+    first = 0;
+    sum = 0.0;
+    count = 0;
+    minimumRows.clear();
+    maximumRows.clear();
+    meanValues.clear();
+    minimumValues.clear();
+    maximumValues.clear();
+}
+
+qsizetype WeatherWindow::size() const
+{
+    return meanValues.size();
+}
+
+const QVector<float> &WeatherWindow::means() const
+{
+    return meanValues;
+}
+
+const QVector<float> &WeatherWindow::minima() const
+{
+    return minimumValues;
+}
+
+const QVector<float> &WeatherWindow::maxima() const
+{
+    return maximumValues;
+}
@@ -0,0 +1,43 @@
+#ifndef WEATHERWINDOW_H
+#define WEATHERWINDOW_H
+
+#include "weatherstore.h"
+#include <QVector>
+#include <deque>
+
+// Moving mean, minimum and maximum of one store column over each row's trailing window of days.
+class WeatherWindow
+{
+public:
+    WeatherWindow(WeatherStore::Column column = WeatherStore::AverageTemperature, int days = 7);
+
+    WeatherStore::Column column() const;
+    int days() const;
+
+    // Continues from the last row seen, so the store may only have grown at its end since
+    void extend(const WeatherStore &store);
+    void reset();
+
+    // One value per store row, NaN where the window holds no measurement
+    qsizetype size() const;
+    const QVector<float> &means() const;
+    const QVector<float> &minima() const;
+    const QVector<float> &maxima() const;
+
+private:
+    WeatherStore::Column valueColumn;
+    int windowDays;
+
+    // Rows [first, means.size()) are in the window; the deques keep only rows that can still become an extreme
+    qsizetype first;
+    double sum;
+    qsizetype count;
+    std::deque<qsizetype> minimumRows;
+    std::deque<qsizetype> maximumRows;
+
+    QVector<float> meanValues;
+    QVector<float> minimumValues;
+    QVector<float> maximumValues;
+};
+
+#endif // WEATHERWINDOW_H